@@ -23,13 +23,105 @@
 #include <QApplication>
 #include <QObject>
 #include <QStyleFactory>
+#include <cstring>
 #include <iostream>
+#include <string>
+#include <vector>
 
 #include <spaghetti/editor.h>
+#include <spaghetti/package.h>
+#include <spaghetti/package_bundle.h>
+#include <spaghetti/package_file.h>
+#include <spaghetti/partition.h>
 #include <spaghetti/registry.h>
 
+namespace {
+
+int run_partition(int argc, char **argv)
+{
+  std::string filename{};
+  std::string listenAddress{};
+  std::string connectAddress{};
+  std::string planCachePath{};
+  size_t peers{ 1 };
+  double time{ 1000.0 };
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string const OPTION{ argv[i] };
+    std::string const VALUE{ argv[i + 1] };
+    if (OPTION == "--partition")
+      filename = VALUE;
+    else if (OPTION == "--listen")
+      listenAddress = VALUE;
+    else if (OPTION == "--connect")
+      connectAddress = VALUE;
+    else if (OPTION == "--peers")
+      peers = std::stoul(VALUE);
+    else if (OPTION == "--time")
+      time = std::stod(VALUE);
+    else if (OPTION == "--plan-cache")
+      planCachePath = VALUE;
+  }
+
+  if (filename.empty() || listenAddress.empty() == connectAddress.empty()) {
+    std::cerr << "Usage: " << argv[0]
+              << " --partition <package> (--listen <address> [--peers <count>] | --connect <address>) [--time <ms>]"
+                 " [--plan-cache <directory>]"
+              << std::endl;
+    return 1;
+  }
+
+  auto &registry = spaghetti::Registry::get();
+  registry.registerInternalElements();
+  registry.loadPlugins();
+  registry.loadPackages();
+  registry.setPlanCachePath(planCachePath);
+
+  spaghetti::Package package{};
+  package.setHeadless(true);
+  package.open(filename);
+
+  spaghetti::Partition partition{ &package };
+  bool const CONNECTED{ listenAddress.empty() ? partition.connect(connectAddress)
+                                              : partition.listen(listenAddress, peers) };
+  if (!CONNECTED || !partition.runFor(spaghetti::Element::duration_t{ time })) return 1;
+
+  for (auto const &OUTPUT : package.outputs())
+    std::visit([&OUTPUT](auto const a_value) { std::cout << OUTPUT.name << " = " << a_value << std::endl; },
+               OUTPUT.value);
+
+  return 0;
+}
+
+int run_convert(int argc, char **argv)
+{
+  if (argc != 4) {
+    std::cerr << "Usage: " << argv[0] << " --convert <from> <to>" << std::endl;
+    return 1;
+  }
+
+  return spaghetti::PackageFile::convert(argv[2], argv[3]) ? 0 : 1;
+}
+
+int run_bundle(int argc, char **argv)
+{
+  if (argc < 4) {
+    std::cerr << "Usage: " << argv[0] << " --bundle <to> <package>..." << std::endl;
+    return 1;
+  }
+
+  std::vector<std::string> const PACKAGES{ argv + 3, argv + argc };
+  return spaghetti::PackageBundle::write(argv[2], PACKAGES) ? 0 : 1;
+}
+
+} // namespace
+
 int main(int argc, char **argv)
 {
+  if (argc > 1 && std::strcmp(argv[1], "--partition") == 0) return run_partition(argc, argv);
+  if (argc > 1 && std::strcmp(argv[1], "--convert") == 0) return run_convert(argc, argv);
+  if (argc > 1 && std::strcmp(argv[1], "--bundle") == 0) return run_bundle(argc, argv);
+
   QApplication app{ argc, argv };
   app.setStyle(QStyleFactory::create("Fusion"));
 
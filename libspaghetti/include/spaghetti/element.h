@@ -31,8 +31,10 @@
 #endif
 // clang-format on
 
+#include <atomic>
 #include <chrono>
 #include <functional>
+#include <memory>
 #include <set>
 #include <string>
 #include <thread>
@@ -42,6 +44,8 @@
 #include <spaghetti/vendor/json.hpp>
 
 #include <spaghetti/api.h>
+#include <spaghetti/small_vector.h>
+#include <spaghetti/state.h>
 #include <spaghetti/strings.h>
 
 namespace spaghetti {
@@ -119,11 +123,21 @@ class SPAGHETTI_API Element {
     std::string name{};
   };
 
-  using IOSockets = std::vector<IOSocket>;
+  // Most elements have one or two sockets each way, those are kept inline in the element.
+  using IOSockets = SmallVector<IOSocket, 2>;
 
   Element() = default;
   virtual ~Element() = default;
 
+  Element &operator=(Element const &) = delete;
+
+  // Copy of the configured state, not attached to any package. Editor bindings (node, event handler) aren't copied.
+  virtual Element *clone() const;
+
+  // Elements are carved from size-classed slabs, see source/slab.h.
+  static void *operator new(size_t const a_size);
+  static void operator delete(void *const a_pointer, size_t const a_size) noexcept;
+
   virtual char const *type() const noexcept = 0;
   virtual string::hash_t hash() const noexcept = 0;
 
@@ -135,25 +149,34 @@ class SPAGHETTI_API Element {
 
   virtual void update(duration_t const &a_delta) { (void)a_delta; }
 
+  // Time left until this element has to be updated again even if none of its inputs change,
+  // duration_t::max() means it only reacts to input changes.
+  virtual duration_t timeToWakeUp() const { return duration_t::max(); }
+
+  // True when the outputs depend on nothing but the current inputs. Feedback loops made only of such elements are
+  // iterated until they settle, a loop through any other element feeds its value back a tick later.
+  virtual bool isCombinational() const { return false; }
+
+  // Runtime state kept outside of the sockets (integrators, edge detectors, running timers), written into simulation
+  // checkpoints next to the socket values. Configuration stays with serialize(), most elements have nothing to add.
+  virtual void saveState(StateWriter &a_state) const { (void)a_state; }
+  virtual void loadState(StateReader &a_state) { (void)a_state; }
+
   size_t id() const noexcept { return m_id; }
 
   void setName(std::string const &a_name);
 
-  std::string name() const noexcept { return m_name; }
+  std::string name() const noexcept { return m_metadata ? m_metadata->name : std::string{}; }
 
-  void setPosition(double const a_x, double const a_y)
-  {
-    m_position.x = a_x;
-    m_position.y = a_y;
-  }
-  void setPosition(vec2d const &a_position) { m_position = a_position; }
-  vec2d const &position() const { return m_position; }
+  void setPosition(double const a_x, double const a_y) { setPosition(vec2d{ a_x, a_y }); }
+  void setPosition(vec2d const &a_position) { metadata().position = a_position; }
+  vec2d const &position() const;
 
-  void iconify(bool const a_iconify) { m_isIconified = a_iconify; }
-  bool isIconified() const { return m_isIconified; }
+  void iconify(bool const a_iconify) { metadata().isIconified = a_iconify; }
+  bool isIconified() const { return m_metadata && m_metadata->isIconified; }
 
-  void setIconifyingHidesCentralWidget(bool const a_hide) { m_iconifyingHidesCentralWidget = a_hide; }
-  bool iconifyingHidesCentralWidget() const { return m_iconifyingHidesCentralWidget; }
+  void setIconifyingHidesCentralWidget(bool const a_hide) { metadata().iconifyingHidesCentralWidget = a_hide; }
+  bool iconifyingHidesCentralWidget() const { return m_metadata && m_metadata->iconifyingHidesCentralWidget; }
 
   IOSockets &inputs() { return m_inputs; }
   IOSockets const &inputs() const { return m_inputs; }
@@ -184,29 +207,47 @@ class SPAGHETTI_API Element {
 
   Package *package() const { return m_package; }
 
+  void wakeUp();
+
+  // Bumped whenever the element may have changed: an edit, a wake up or a tick that changed its sockets. Package
+  // snapshots copy an element again only when its revision moved, the serial tells apart elements reusing an address.
+  void touch();
+  uint64_t revision() const { return m_revision.load(std::memory_order_relaxed); }
+  uint64_t serial() const { return m_serial; }
+
   void resetIOSocketValue(IOSocket &a_io);
 
-  void setNode(void *const a_node) { m_node = a_node; }
+  void setNode(void *const a_node) { metadata().node = a_node; }
 
   template<typename T>
   T *node()
   {
-    return static_cast<T *>(m_node);
+    return static_cast<T *>(m_metadata ? m_metadata->node : nullptr);
   }
 
-  void registerEventHandler(EventCallback const &a_handler) { m_handler = a_handler; }
+  void registerEventHandler(EventCallback const &a_handler) { metadata().handler = a_handler; }
 
  protected:
+  Element(Element const &a_other);
+
   void handleEvent(Event const &a_event);
   virtual void onEvent(Event const &a_event) { (void)a_event; }
 
   void setMinInputs(uint8_t const a_min);
   void setMaxInputs(uint8_t const a_max);
-  void setDefaultNewInputFlags(uint8_t const a_flags) { m_defaultNewInputFlags = a_flags; }
+  void setDefaultNewInputFlags(uint8_t const a_flags)
+  {
+    m_defaultNewInputFlags = a_flags;
+    touch();
+  }
 
   void setMinOutputs(uint8_t const a_min);
   void setMaxOutputs(uint8_t const a_max);
-  void setDefaultNewOutputFlags(uint8_t const a_flags) { m_defaultNewOutputFlags = a_flags; }
+  void setDefaultNewOutputFlags(uint8_t const a_flags)
+  {
+    m_defaultNewOutputFlags = a_flags;
+    touch();
+  }
 
  protected:
   IOSockets m_inputs{};
@@ -215,20 +256,33 @@ class SPAGHETTI_API Element {
   friend class Package;
   Package *m_package{};
 
+ private:
+  // Editor-only state, kept out of line so the per-tick data of neighbouring elements stays close together.
+  // It's allocated on first use, elements of a headless package never get one. Clones share it until either
+  // side writes to it.
+  struct Metadata {
+    std::string name{};
+    vec2d position{};
+    bool isIconified{};
+    bool iconifyingHidesCentralWidget{};
+    EventCallback handler{};
+    void *node{};
+  };
+
+  Metadata &metadata();
+  static uint64_t nextSerial();
+
  private:
   size_t m_id{};
-  std::string m_name{};
-  vec2d m_position{};
-  bool m_isIconified{};
-  bool m_iconifyingHidesCentralWidget{};
+  uint64_t const m_serial{ nextSerial() };
+  std::atomic<uint64_t> m_revision{};
+  std::shared_ptr<Metadata> m_metadata{};
   uint8_t m_minInputs{};
   uint8_t m_maxInputs{ std::numeric_limits<uint8_t>::max() };
   uint8_t m_minOutputs{};
   uint8_t m_maxOutputs{ std::numeric_limits<uint8_t>::max() };
   uint8_t m_defaultNewInputFlags{};
   uint8_t m_defaultNewOutputFlags{};
-  EventCallback m_handler{};
-  void *m_node{};
 };
 
 template<typename T>
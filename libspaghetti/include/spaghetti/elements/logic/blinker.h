@@ -25,6 +25,7 @@
 #define SPAGHETTI_ELEMENTS_LOGIC_BLINKER_H
 
 #include <spaghetti/element.h>
+#include <spaghetti/timer_wheel.h>
 
 namespace spaghetti::elements::logic {
 
@@ -38,16 +39,20 @@ class Blinker final : public Element {
   char const *type() const noexcept override { return TYPE; }
   string::hash_t hash() const noexcept override { return HASH; }
 
-  void update(duration_t const &a_delta) override;
-
   void calculate() override;
 
+  void saveState(StateWriter &a_state) const override;
+  void loadState(StateReader &a_state) override;
+
+ private:
+  void schedule(duration_t const &a_timeout);
+
  private:
   bool m_enabled{};
   bool m_state{};
   duration_t m_highRate{};
   duration_t m_lowRate{};
-  duration_t m_time{};
+  TimerWheel::Timer m_timer{};
 };
 
 } // namespace spaghetti::elements::logic
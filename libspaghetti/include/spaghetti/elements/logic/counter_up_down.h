@@ -40,6 +40,9 @@ class CounterUpDown final : public Element {
 
   void calculate() override;
 
+  void saveState(StateWriter &a_state) const override;
+  void loadState(StateReader &a_state) override;
+
  private:
   int32_t m_preset{};
   int32_t m_current{};
@@ -40,6 +40,9 @@ class MemoryDifference final : public Element {
 
   void calculate() override;
 
+  void saveState(StateWriter &a_state) const override;
+  void loadState(StateReader &a_state) override;
+
  private:
   int32_t m_currentValue{};
   int32_t m_lastValue{};
@@ -42,9 +42,16 @@ class PID final : public Element {
 
   void calculate() override;
 
+  void saveState(StateWriter &a_state) const override;
+  void loadState(StateReader &a_state) override;
+
+  duration_t timeToWakeUp() const override { return m_steady ? duration_t::max() : duration_t::zero(); }
+
  private:
+  bool m_steady{};
   float m_delta{};
   float m_integral{};
+  float m_derivative{};
   float m_lastError{};
 };
 
@@ -40,6 +40,9 @@ class SnapshotInt final : public Element {
 
   void calculate() override;
 
+  void saveState(StateWriter &a_state) const override;
+  void loadState(StateReader &a_state) override;
+
  private:
   int32_t m_value{};
 };
@@ -40,6 +40,9 @@ class TriggerFalling final : public Element {
 
   void calculate() override;
 
+  void saveState(StateWriter &a_state) const override;
+  void loadState(StateReader &a_state) override;
+
  private:
   enum class State { eWait, eSet, eReset };
   State m_state{};
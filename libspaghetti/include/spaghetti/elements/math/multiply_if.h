@@ -40,6 +40,9 @@ class MultiplyIf final : public Element {
 
   void calculate() override;
 
+  void saveState(StateWriter &a_state) const override;
+  void loadState(StateReader &a_state) override;
+
  private:
   bool m_enabled{};
 };
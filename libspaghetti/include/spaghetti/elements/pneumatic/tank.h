@@ -41,7 +41,12 @@ class Tank final : public Element {
   void serialize(Json &a_json) override;
   void deserialize(Json const &a_json) override;
 
+  void update(duration_t const &a_delta) override;
   void calculate() override;
+  duration_t timeToWakeUp() const override { return m_deltaP != 0.f ? duration_t::zero() : duration_t::max(); }
+
+  void saveState(StateWriter &a_state) const override;
+  void loadState(StateReader &a_state) override;
 
   void setInitialPressure(float const a_pressure);
   float initialPressure() const { return m_initialPressure; }
@@ -53,6 +58,8 @@ class Tank final : public Element {
   float m_initialPressure{};
   float m_pressure{};
   float m_volume{};
+  float m_deltaP{};
+  float m_deltaMs{};
 };
 
 } // namespace spaghetti::elements::pneumatic
@@ -40,6 +40,10 @@ class Valve final : public Element {
 
   void update(duration_t const &a_delta) override;
   void calculate() override;
+  duration_t timeToWakeUp() const override { return m_deltaP != 0.f ? duration_t::zero() : duration_t::max(); }
+
+  void saveState(StateWriter &a_state) const override;
+  void loadState(StateReader &a_state) override;
 
  private:
   float m_deltaS{};
@@ -27,6 +27,7 @@
 #include <chrono>
 
 #include <spaghetti/element.h>
+#include <spaghetti/timer_wheel.h>
 
 namespace spaghetti::elements::timers {
 
@@ -43,16 +44,28 @@ class Clock final : public Element {
   void serialize(Json &a_json) override;
   void deserialize(Json const &a_json) override;
 
-  void reset() override { m_time = duration_t{ 0.0 }; }
-  void update(duration_t const &a_delta) override;
+  void reset() override { m_restart = true; }
+  void calculate() override;
 
-  void setDuration(duration_t a_duration) { m_duration = a_duration; }
+  void saveState(StateWriter &a_state) const override;
+  void loadState(StateReader &a_state) override;
+
+  void setDuration(duration_t a_duration)
+  {
+    m_duration = a_duration;
+    m_restart = true;
+    wakeUp();
+  }
 
   duration_t duration() const { return m_duration; }
 
  private:
-  duration_t m_time{};
+  void schedule(duration_t const &a_timeout);
+
+ private:
   duration_t m_duration{ 500 };
+  bool m_restart{ true };
+  TimerWheel::Timer m_timer{};
 };
 
 } // namespace spaghetti::elements::timers
@@ -41,6 +41,7 @@ class DeltaTime final : public Element {
   string::hash_t hash() const noexcept override { return HASH; }
 
   void update(duration_t const &a_delta) override;
+  duration_t timeToWakeUp() const override { return duration_t::zero(); }
 
  private:
   duration_t m_delta{};
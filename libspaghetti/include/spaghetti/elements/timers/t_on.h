@@ -27,6 +27,7 @@
 #include <chrono>
 
 #include <spaghetti/element.h>
+#include <spaghetti/timer_wheel.h>
 
 namespace spaghetti::elements::timers {
 
@@ -40,16 +41,25 @@ class TimerOn final : public Element {
   char const *type() const noexcept override { return TYPE; }
   string::hash_t hash() const noexcept override { return HASH; }
 
-  void update(duration_t const &a_delta) override;
   void calculate() override;
+  // The wheel only ends the run, the elapsed time still counts up every step until then.
+  duration_t timeToWakeUp() const override { return m_state == State::eRun ? duration_t::zero() : duration_t::max(); }
+
+  void saveState(StateWriter &a_state) const override;
+  void loadState(StateReader &a_state) override;
 
  private:
   enum class State { eWaitForTrigger, eRun, eDone, eReset };
 
+  void schedule();
+
+ private:
   duration_t m_presetTime{};
+  duration_t m_startTime{};
   duration_t m_elapsedTime{};
   State m_state{};
   bool m_lastInput{};
+  TimerWheel::Timer m_timer{};
 };
 
 } // namespace spaghetti::elements::timers
@@ -37,6 +37,7 @@ class IntInfo final : public Element {
 
   char const *type() const noexcept override { return TYPE; }
   string::hash_t hash() const noexcept override { return HASH; }
+  bool isCombinational() const override { return true; }
 };
 
 } // namespace spaghetti::elements::ui
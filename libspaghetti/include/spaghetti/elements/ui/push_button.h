@@ -41,6 +41,9 @@ class PushButton final : public Element {
   void toggle();
   void set(bool a_state);
 
+  void saveState(StateWriter &a_state) const override;
+  void loadState(StateReader &a_state) override;
+
   bool currentValue() const { return m_currentValue; }
 
  private:
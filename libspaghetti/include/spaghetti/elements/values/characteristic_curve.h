@@ -40,6 +40,7 @@ class CharacteristicCurve : public Element {
 
   char const *type() const noexcept override { return TYPE; }
   string::hash_t hash() const noexcept override { return HASH; }
+  bool isCombinational() const override { return true; }
 
   void calculate() override;
 
@@ -49,31 +50,67 @@ class CharacteristicCurve : public Element {
   void setSeriesCount(size_t const a_seriesCount);
   size_t seriesCount() const { return m_series.size(); }
 
-  void setXMinimum(float const a_xMin) { m_xRange.x = a_xMin; }
+  void setXMinimum(float const a_xMin)
+  {
+    m_xRange.x = a_xMin;
+    wakeUp();
+  }
   float xMinimum() const { return m_xRange.x; }
 
-  void setXMaximum(float const a_xMax) { m_xRange.y = a_xMax; }
+  void setXMaximum(float const a_xMax)
+  {
+    m_xRange.y = a_xMax;
+    wakeUp();
+  }
   float xMaximum() const { return m_xRange.y; }
 
-  void setYMinimum(float const a_yMin) { m_yRange.x = a_yMin; }
+  void setYMinimum(float const a_yMin)
+  {
+    m_yRange.x = a_yMin;
+    wakeUp();
+  }
   float yMinimum() const { return m_yRange.x; }
 
-  void setYMaximum(float const a_yMax) { m_yRange.y = a_yMax; }
+  void setYMaximum(float const a_yMax)
+  {
+    m_yRange.y = a_yMax;
+    wakeUp();
+  }
   float yMaximum() const { return m_yRange.y; }
 
-  void setXMajorTicks(int32_t const a_xMajorTicks) { m_xTicks.x = a_xMajorTicks; }
+  void setXMajorTicks(int32_t const a_xMajorTicks)
+  {
+    m_xTicks.x = a_xMajorTicks;
+    wakeUp();
+  }
   int32_t xMajorTicks() const { return m_xTicks.x; }
 
-  void setXMinorTicks(int32_t const a_xMinorTicks) { m_xTicks.y = a_xMinorTicks; }
+  void setXMinorTicks(int32_t const a_xMinorTicks)
+  {
+    m_xTicks.y = a_xMinorTicks;
+    wakeUp();
+  }
   int32_t xMinorTicks() const { return m_xTicks.y; }
 
-  void setYMajorTicks(int32_t const a_yMajorTicks) { m_yTicks.x = a_yMajorTicks; }
+  void setYMajorTicks(int32_t const a_yMajorTicks)
+  {
+    m_yTicks.x = a_yMajorTicks;
+    wakeUp();
+  }
   int32_t yMajorTicks() const { return m_yTicks.x; }
 
-  void setYMinorTicks(int32_t const a_yMinorTicks) { m_yTicks.y = a_yMinorTicks; }
+  void setYMinorTicks(int32_t const a_yMinorTicks)
+  {
+    m_yTicks.y = a_yMinorTicks;
+    wakeUp();
+  }
   int32_t yMinorTicks() const { return m_yTicks.y; }
 
-  Series &series() { return m_series; }
+  Series &series()
+  {
+    wakeUp();
+    return m_series;
+  }
   Series const &series() const { return m_series; }
 
   void clearSeries();
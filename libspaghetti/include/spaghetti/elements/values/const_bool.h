@@ -37,6 +37,7 @@ class ConstBool final : public Element {
 
   char const *type() const noexcept override { return TYPE; }
   string::hash_t hash() const noexcept override { return HASH; }
+  bool isCombinational() const override { return true; }
 
   void serialize(Json &a_json) override;
   void deserialize(Json const &a_json) override;
@@ -45,6 +45,9 @@ class RandomFloat final : public Element {
 
   void calculate() override;
 
+  void saveState(StateWriter &a_state) const override;
+  void loadState(StateReader &a_state) override;
+
   void setMin(float const a_min) { setRange(a_min, max()); }
   float min() const { return m_min; }
   void setMax(float const a_max) { setRange(min(), a_max); }
@@ -56,6 +59,7 @@ class RandomFloat final : public Element {
     m_max = std::max<float>(a_min, a_max);
 
     updateDistribution();
+    touch();
   }
 
  private:
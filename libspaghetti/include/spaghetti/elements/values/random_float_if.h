@@ -45,6 +45,13 @@ class RandomFloatIf final : public Element {
 
   void update(duration_t const &a_delta) override;
   void calculate() override;
+  duration_t timeToWakeUp() const override
+  {
+    return std::max(duration_t::zero(), (m_enabled ? m_enabledInterval : m_disabledInterval) - m_elapsed);
+  }
+
+  void saveState(StateWriter &a_state) const override;
+  void loadState(StateReader &a_state) override;
 
   void setEnabledMin(float const a_min) { setEnabledRange(a_min, enabledMax()); }
   float enabledMin() const { return m_enabledMin; }
@@ -57,6 +64,7 @@ class RandomFloatIf final : public Element {
     m_enabledMax = std::max<float>(a_min, a_max);
 
     updateDistributions();
+    touch();
   }
 
   void setDisabledMin(float const a_min) { setDisabledRange(a_min, disabledMax()); }
@@ -70,6 +78,7 @@ class RandomFloatIf final : public Element {
     m_disabledMax = std::max<float>(a_min, a_max);
 
     updateDistributions();
+    touch();
   }
 
  private:
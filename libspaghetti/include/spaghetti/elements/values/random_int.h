@@ -45,6 +45,9 @@ class RandomInt final : public Element {
 
   void calculate() override;
 
+  void saveState(StateWriter &a_state) const override;
+  void loadState(StateReader &a_state) override;
+
   void setMin(int32_t const a_min) { setRange(a_min, max()); }
   int32_t min() const { return m_min; }
   void setMax(int32_t const a_max) { setRange(min(), a_max); }
@@ -56,6 +59,7 @@ class RandomInt final : public Element {
     m_max = std::max<int32_t>(a_min, a_max);
 
     updateDistribution();
+    touch();
   }
 
  private:
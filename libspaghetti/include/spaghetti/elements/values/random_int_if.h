@@ -45,6 +45,13 @@ class RandomIntIf final : public Element {
 
   void update(duration_t const &a_delta) override;
   void calculate() override;
+  duration_t timeToWakeUp() const override
+  {
+    return std::max(duration_t::zero(), (m_enabled ? m_enabledInterval : m_disabledInterval) - m_elapsed);
+  }
+
+  void saveState(StateWriter &a_state) const override;
+  void loadState(StateReader &a_state) override;
 
   void setEnabledMin(int32_t const a_min) { setEnabledRange(a_min, enabledMax()); }
   int32_t enabledMin() const { return m_enabledMin; }
@@ -57,6 +64,7 @@ class RandomIntIf final : public Element {
     m_enabledMax = std::max<int32_t>(a_min, a_max);
 
     updateDistributions();
+    touch();
   }
 
   void setDisabledMin(int32_t const a_min) { setDisabledRange(a_min, disabledMax()); }
@@ -70,6 +78,7 @@ class RandomIntIf final : public Element {
     m_disabledMax = std::max<int32_t>(a_min, a_max);
 
     updateDistributions();
+    touch();
   }
 
  private:
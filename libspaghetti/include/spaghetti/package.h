@@ -25,6 +25,14 @@
 #define SPAGHETTI_PACKAGE_H
 
 #include <atomic>
+#include <condition_variable>
+#include <future>
+#include <istream>
+#include <ostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <queue>
 
 // clang-format off
 #ifdef _MSC_VER
@@ -36,8 +44,10 @@
 
 #include <spaghetti/api.h>
 #include <spaghetti/element.h>
+#include <spaghetti/package_file.h>
 #include <spaghetti/strings.h>
 #include <spaghetti/registry.h>
+#include <spaghetti/timer_wheel.h>
 
 // clang-format off
 #define PACKAGE_SPP_MAP 1
@@ -63,7 +73,15 @@ class SPAGHETTI_API Package final : public Element {
 
   using Connections = std::vector<Connection>;
 
+  // Element ids get reused after removal and renumbered by compact(), a handle also carries the generation
+  // of its slot so a stale one is detected instead of resolving to whatever lives there now.
+  struct Handle {
+    size_t id{};
+    uint32_t generation{};
+  };
+
   Package();
+  Package(Package const &a_other);
   ~Package() override;
 
   static constexpr char const *const TYPE{ "logic/package" };
@@ -76,16 +94,44 @@ class SPAGHETTI_API Package final : public Element {
   void deserialize(Json const &a_json) override;
 
   void calculate() override;
-  void update(duration_t const &a_delta) override { m_delta = a_delta; }
+  void update(duration_t const &a_delta) override;
+  duration_t timeToWakeUp() const override;
+
+  void saveState(StateWriter &a_state) const override;
+  void loadState(StateReader &a_state) override;
 
   std::string_view packageDescription() const { return m_packageDescription; }
-  void setPackageDescription(std::string const &a_description) { m_packageDescription = a_description; }
+  void setPackageDescription(std::string const &a_description)
+  {
+    m_packageDescription = a_description;
+    touch();
+  }
 
   std::string_view packagePath() const { return m_packagePath; }
-  void setPackagePath(std::string const &a_path) { m_packagePath = a_path; }
+  void setPackagePath(std::string const &a_path)
+  {
+    m_packagePath = a_path;
+    touch();
+  }
 
   std::string_view packageIcon() const { return m_packageIcon; }
-  void setPackageIcon(std::string const &a_icon) { m_packageIcon = a_icon; }
+  void setPackageIcon(std::string const &a_icon)
+  {
+    m_packageIcon = a_icon;
+    touch();
+  }
+
+  // A package with divisor N runs every Nth tick with the delta of all N, elements integrating over time have to
+  // scale by that delta to give the same results as undecimated.
+  uint32_t rateDivisor() const { return m_rateDivisor; }
+  void setRateDivisor(uint32_t const a_divisor);
+
+  size_t workerCount() const { return m_workerCount; }
+  void setWorkerCount(size_t const a_count);
+
+  // Headless packages skip editor metadata (names, positions) of their elements when loading.
+  bool isHeadless() const { return m_package ? m_package->isHeadless() : m_isHeadless; }
+  void setHeadless(bool const a_headless) { m_isHeadless = a_headless; }
 
   Element *add(char const *const a_name) { return add(string::hash(a_name)); }
   Element *add(string::hash_t const a_hash);
@@ -94,72 +140,283 @@ class SPAGHETTI_API Package final : public Element {
   void remove(size_t const a_id);
 
   Element *get(size_t const a_id) const;
+  Element *get(Handle const &a_handle) const;
+  Handle handle(size_t const a_id) const;
+
+  class Snapshot;
+  // Frozen copy of the package taken between two ticks, consumers read it at leisure from any thread.
+  std::shared_ptr<Snapshot const> snapshot();
+
+  void compact();
 
   bool connect(size_t const a_sourceId, uint8_t const a_sourceSocket, size_t const a_targetId,
                uint8_t const a_targetSocket);
   bool disconnect(size_t const a_sourceId, uint8_t const a_outputId, size_t const a_targetId, uint8_t const a_inputId);
 
+  // Connections are indexed by target socket, which has at most one driver, and by source socket, which may fan
+  // out to many. Both return indices into connections(), which are only stable until the next (dis)connect.
+  static constexpr size_t const NO_CONNECTION{ std::numeric_limits<size_t>::max() };
+  size_t driverOf(size_t const a_targetId, uint8_t const a_targetSocket) const;
+  std::vector<size_t> const &fanOutOf(size_t const a_sourceId, uint8_t const a_sourceSocket) const;
+
   void dispatchThreadFunction();
 
+  void runFor(duration_t const &a_time);
+  duration_t simulationTime() const { return m_simulationTime; }
+  void setSimulationStep(duration_t const &a_step) { m_simulationStep = a_step; }
+  duration_t simulationStep() const { return m_simulationStep; }
+
   void startDispatchThread();
   void quitDispatchThread();
   void pauseDispatchThread();
   void resumeDispatchThread();
+  void wakeDispatchThread();
+
+  TimerWheel &timerWheel() { return m_package ? m_package->timerWheel() : m_timerWheel; }
 
   void setInputsPosition(double const a_x, double const a_y);
-  void setInputsPosition(vec2d const a_position) { m_inputsPosition = a_position; }
+  void setInputsPosition(vec2d const a_position) { setInputsPosition(a_position.x, a_position.y); }
   vec2d const &inputsPosition() const { return m_inputsPosition; }
 
   void setOutputsPosition(double const a_x, double const a_y);
-  void setOutputsPosition(vec2d const a_position) { m_outputsPosition = a_position; }
+  void setOutputsPosition(vec2d const a_position) { setOutputsPosition(a_position.x, a_position.y); }
   vec2d const &outputsPosition() const { return m_outputsPosition; }
 
   Elements const &elements() const { return m_elements; }
-  Connections const &connections() const { return m_connections; }
+  Connections const &connections() const { return m_wiring->connections; }
 
   void open(std::string const &a_filename);
   void save(std::string const &a_filename);
+  // Takes a snapshot and writes it on a background thread.
+  std::future<bool> saveAsync(std::string const &a_filename);
+
+  // With journaling on, saving appends the edits since the previous save to a journal next to the file instead of
+  // rewriting it, the file itself is rewritten in the background once the journal outgrows it. See PackageJournal.
+  void setJournaling(bool const a_journaling) { m_journaling = a_journaling; }
+  bool journaling() const { return m_journaling; }
+
+  // Runtime state of the whole simulation (socket values, element state, timers and the simulation clock) as a
+  // binary blob, to resume a long running simulation where it stopped. It only restores into a package with the
+  // same layout, i.e. opened from the same file, anything else is rejected before touching the package.
+  std::vector<uint8_t> checkpoint();
+  bool restore(std::vector<uint8_t> const &a_checkpoint);
+  bool saveCheckpoint(std::string const &a_filename);
+  bool loadCheckpoint(std::string const &a_filename);
+
+  // Used by save() when the extension doesn't pick a format, open() keeps the format the file was in.
+  PackageFile::Format fileFormat() const { return m_fileFormat; }
+  void setFileFormat(PackageFile::Format const a_format) { m_fileFormat = a_format; }
 
   static Registry::PackageInfo getInfoFor(std::string const &a_filename);
 
  private:
+  static size_t socketKey(size_t const a_id, uint8_t const a_socket) { return (a_id << 8) | a_socket; }
+  void addConnection(Connection const &a_connection);
+  void eraseConnection(size_t const a_index);
+  void rebuildConnectionIndex();
+  void unshareWiring();
+  void invalidatePlan();
+
+  void serializeHeader(Json &a_json);
+
+  void resetJournal(std::string const &a_base, std::vector<size_t> const &a_fileIds);
+  bool appendJournal(std::string const &a_filename);
+  std::shared_future<bool> rewrite(std::string const &a_filename);
+  Connections journalConnections() const;
+  std::shared_ptr<Snapshot const> takeSnapshot();
+
+  void copyContents(Package const &a_other);
+  void load(PackageFile const &a_file);
+  void load(std::istream &a_stream);
+  void settle(duration_t const &a_delta);
+  void scheduleWakeUps();
+  void buildPlan() const;
+  uint64_t planKey() const;
+  bool readPlan(std::string const &a_filename, uint64_t const a_key) const;
+  void writePlan(std::string const &a_filename, uint64_t const a_key) const;
+  void partitionPlan();
+  bool pullInputs(size_t const a_id);
+  bool evaluate(Element *const a_element, duration_t const &a_delta, std::vector<Value> &a_lastOutputs);
+  bool runPartition(size_t const a_partition);
+  void startWorkers();
+  void stopWorkers();
+  void workerThreadFunction(size_t const a_partition, uint64_t const a_generation);
+
+ private:
+  struct ScheduledEvent {
+    duration_t time{};
+    size_t id{};
+    bool operator>(ScheduledEvent const &a_other) const { return time > a_other.time; }
+  };
+  using EventQueue = std::priority_queue<ScheduledEvent, std::vector<ScheduledEvent>, std::greater<ScheduledEvent>>;
+
+  // Elements are evaluated in topological order of their strongly connected
+  // components; a cyclic step (more than one member or a self loop) of
+  // combinational elements is iterated until its outputs settle. Any other
+  // component runs once, its back edges read the value from the last tick.
+  // Members are ordered from where the loop is entered, not by id.
+  struct PlanStep {
+    size_t first{};
+    size_t count{};
+    bool cyclic{};
+  };
+
   duration_t m_delta{};
   std::string m_packageDescription{ "A package" };
   std::string m_packagePath{};
   std::string m_packageIcon{ ":/unknown.png" };
+  uint32_t m_rateDivisor{ 1 };
+  uint32_t m_skippedTicks{};
   vec2d m_inputsPosition{ -400.0, 0.0 };
   vec2d m_outputsPosition{ 400.0, 0.0 };
   Elements m_elements{};
-  Connections m_connections{};
 
   std::vector<size_t> m_free{};
+  std::vector<uint32_t> m_generations{ 0 };
 
 #if PACKAGE_MAP == PACKAGE_SPP_MAP
-  using Callbacks = spp::sparse_hash_map<size_t, std::vector<size_t>>;
+  using Drivers = spp::sparse_hash_map<size_t, size_t>;
+  using FanOuts = spp::sparse_hash_map<size_t, std::vector<size_t>>;
 #elif PACKAGE_MAP == PACKAGE_STD_UNORDERED_MAP
-  using Callbacks = std::unordered_map<size_t, std::vector<size_t>>;
+  using Drivers = std::unordered_map<size_t, size_t>;
+  using FanOuts = std::unordered_map<size_t, std::vector<size_t>>;
 #endif
 
-  Callbacks m_dependencies{};
+  // Connections and everything derived from them only depend on the element layout, so instances cloned from
+  // the same external package share one copy until one of them is edited.
+  struct Wiring {
+    Connections connections{};
+    // Keyed by socketKey(), fanOutSlots holds each connection's position in its source's fan-out list so it can
+    // be swapped out in O(1).
+    Drivers drivers{};
+    FanOuts fanOuts{};
+    std::vector<size_t> fanOutSlots{};
+    std::vector<PlanStep> plan{};
+    std::vector<size_t> planOrder{};
+    std::vector<std::vector<size_t>> incoming{};
+    std::vector<size_t> outgoing{};
+    std::vector<size_t> delayed{};
+    bool planDirty{ true };
+  };
+
+  std::shared_ptr<Wiring> m_wiring{ std::make_shared<Wiring>() };
+
+  // Copies handed to the last snapshot, the next one reuses those whose element kept its serial and revision.
+  // Nested packages get a snapshot of their own instead of a copy, only the changed elements inside are cloned.
+  struct SnapshotSlot {
+    std::shared_ptr<Element> copy{};
+    std::shared_ptr<Snapshot const> package{};
+    uint64_t serial{};
+    uint64_t revision{};
+  };
+  std::vector<SnapshotSlot> m_snapshotSlots{};
+
+  // What the journaled file holds, by element id. fileId is the element's position in the file, hash that of the
+  // Json last written for it (0 when unknown), revisions that moved without changing it don't get written again.
+  struct JournalSlot {
+    uint64_t serial{};
+    uint64_t revision{};
+    uint64_t hash{};
+    size_t fileId{};
+  };
+  struct Journal {
+    std::string base{};
+    std::vector<JournalSlot> slots{};
+    std::shared_ptr<Wiring const> wiring{};
+    Connections connections{};
+    Json header{};
+    size_t nextFileId{ 1 };
+    bool started{};
+    std::shared_future<bool> pending{};
+  };
+  Journal m_journal{};
+  bool m_journaling{};
+  std::vector<uint8_t> m_warnedSteps{};
+  bool m_partitionsDirty{ true };
+
+  // With more than one worker the plan is split into partitions with as few connections between them as
+  // possible. Values crossing partitions are published once per tick, so such edges see last tick's value.
+  size_t m_workerCount{ 1 };
+  std::vector<std::vector<size_t>> m_partitions{};
+  std::vector<std::vector<Value>> m_lastOutputs{};
+  std::vector<uint8_t> m_partitionChanged{};
+  std::vector<int32_t> m_cutSlots{};
+  std::vector<size_t> m_cutConnections{};
+  std::vector<Value> m_cutValues{};
+  std::vector<std::thread> m_workers{};
+  std::mutex m_workMutex{};
+  std::condition_variable m_workCondition{};
+  std::condition_variable m_workDoneCondition{};
+  uint64_t m_workGeneration{};
+  size_t m_pendingWorkers{};
+  bool m_stopWorkers{};
+  bool m_changed{ true };
+  duration_t m_simulationTime{};
+  duration_t m_simulationStep{ 1.0 };
+  TimerWheel m_timerWheel{};
+  EventQueue m_events{};
+  std::vector<duration_t> m_deadlines{};
   std::thread m_dispatchThread{};
+  std::mutex m_wakeUpMutex{};
+  std::condition_variable m_wakeUpCondition{};
+  bool m_wakeUp{};
   std::atomic_bool m_dispatchThreadStarted{};
   std::atomic_bool m_quit{};
   std::atomic_bool m_pause{};
   std::atomic_bool m_paused{};
   std::atomic_uint32_t m_pauseCount{};
   bool m_isExternal{};
+  bool m_isHeadless{};
+  PackageFile::Format m_fileFormat{ PackageFile::Format::eJson };
+};
+
+class SPAGHETTI_API Package::Snapshot final {
+ public:
+  using Json = Element::Json;
+  using duration_t = Element::duration_t;
+
+  // Indexed by element id like Package::get(), removed elements leave empty slots. Nested packages aren't copied,
+  // get() returns nullptr for them and package() their own snapshot.
+  Element const *get(size_t const a_id) const { return a_id < m_elements.size() ? m_elements[a_id].get() : nullptr; }
+  Snapshot const *package(size_t const a_id) const
+  {
+    return a_id < m_packages.size() ? m_packages[a_id].get() : nullptr;
+  }
+  size_t size() const { return m_elements.size(); }
+  Connections const &connections() const { return m_wiring->connections; }
+  duration_t simulationTime() const { return m_simulationTime; }
+
+  void serialize(Json &a_json) const;
+  void writeJson(std::ostream &a_stream) const;
+  bool write(std::string const &a_filename) const;
+
+ private:
+  friend class Package;
+
+  std::vector<size_t> denseIds() const;
+  Json serializeElement(size_t const a_id, size_t const a_denseId) const;
+
+  Json m_header{};
+  std::vector<std::shared_ptr<Element>> m_elements{};
+  std::vector<std::shared_ptr<Snapshot const>> m_packages{};
+  std::shared_ptr<Wiring const> m_wiring{};
+  PackageFile::Format m_fileFormat{};
+  duration_t m_simulationTime{};
+  bool m_isExternal{};
 };
 
 inline void Package::setInputsPosition(double const a_x, double const a_y)
 {
   m_inputsPosition.x = a_x;
   m_inputsPosition.y = a_y;
+  touch();
 }
 
 inline void Package::setOutputsPosition(double const a_x, double const a_y)
 {
   m_outputsPosition.x = a_x;
   m_outputsPosition.y = a_y;
+  touch();
 }
 
 } // namespace spaghetti
@@ -0,0 +1,89 @@
+// MIT License
+//
+// Copyright (c) 2017-2018 Artur Wyszyński, aljen at hitomi dot pl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#ifndef SPAGHETTI_PACKAGE_BUNDLE_H
+#define SPAGHETTI_PACKAGE_BUNDLE_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <spaghetti/api.h>
+#include <spaghetti/element.h>
+
+namespace spaghetti {
+
+// Many packages in a single file. A header points at an index sorted by package path, each entry holding the
+// path, icon and the CBOR document of one package, so opening a bundle is a mmap and listing it touches only the
+// index. Packages are decoded one at a time, when first asked for.
+//
+// A package inside a bundle is named "<bundle>#<path>" wherever a package filename is expected.
+class SPAGHETTI_API PackageBundle final {
+ public:
+  using Json = Element::Json;
+
+  static constexpr char const *const EXTENSION{ ".spbundle" };
+  static constexpr char const SEPARATOR{ '#' };
+  static constexpr uint32_t const MAGIC{ 0x4E425053 }; // "SPBN"
+  static constexpr uint16_t const VERSION{ 1 };
+
+  struct Entry {
+    std::string_view path{};
+    std::string_view icon{};
+  };
+
+  PackageBundle() = default;
+  ~PackageBundle();
+
+  PackageBundle(PackageBundle const &) = delete;
+  PackageBundle &operator=(PackageBundle const &) = delete;
+
+  static std::string memberFilename(std::string const &a_bundle, std::string const &a_path);
+  // Splits a member filename into the bundle and package path, false for plain package files.
+  static bool split(std::string const &a_filename, std::string &a_bundle, std::string &a_path);
+  static bool isMember(std::string const &a_filename);
+
+  // Reads the package named by a member filename.
+  static bool read(std::string const &a_filename, Json &a_json);
+  // Packs a_packages into a_filename, a package registered under the same path as an earlier one replaces it.
+  static bool write(std::string const &a_filename, std::vector<std::string> const &a_packages);
+
+  bool open(std::string const &a_filename);
+  void close();
+  bool isOpen() const { return m_data != nullptr; }
+
+  size_t size() const;
+  Entry entry(size_t const a_index) const;
+  bool find(std::string_view const a_path, Json &a_json) const;
+
+ private:
+  uint8_t const *m_data{};
+  size_t m_size{};
+  std::vector<uint8_t> m_buffer{};
+  bool m_mapped{};
+};
+
+} // namespace spaghetti
+
+#endif // SPAGHETTI_PACKAGE_BUNDLE_H
@@ -0,0 +1,109 @@
+// MIT License
+//
+// Copyright (c) 2017-2018 Artur Wyszyński, aljen at hitomi dot pl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+#ifndef SPAGHETTI_PACKAGE_FILE_H
+#define SPAGHETTI_PACKAGE_FILE_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <spaghetti/api.h>
+#include <spaghetti/element.h>
+
+namespace spaghetti {
+
+// Package files on disk. Besides text JSON, packages can be stored as CBOR or MessagePack documents (same Json,
+// smaller and faster to parse) or in the binary .spkg format.
+//
+// A .spkg header points at a string table, a table of fixed size element records (the root package first), their
+// sockets and the connections, so opening one is a mmap and a bounds check. Whatever isn't covered by a record
+// (element properties, inline packages) is kept next to it as CBOR, an element or document that doesn't fit the
+// records is stored whole that way, which keeps the JSON round trip lossless.
+class SPAGHETTI_API PackageFile final {
+ public:
+  using Json = Element::Json;
+
+  enum class Format { eJson, eCbor, eMsgPack, eBinary };
+
+  static constexpr char const *const EXTENSION{ ".spkg" };
+  static constexpr char const *const CBOR_EXTENSION{ ".cbor" };
+  static constexpr char const *const MSGPACK_EXTENSION{ ".msgpack" };
+  static constexpr uint32_t const MAGIC{ 0x474B5053 }; // "SPKG"
+  static constexpr uint16_t const VERSION{ 1 };
+
+  struct Connection {
+    uint64_t from_id{};
+    uint64_t to_id{};
+    uint8_t from_socket{};
+    uint8_t to_socket{};
+  };
+
+  PackageFile() = default;
+  ~PackageFile();
+
+  PackageFile(PackageFile const &) = delete;
+  PackageFile &operator=(PackageFile const &) = delete;
+
+  // The format is picked by extension when writing, a file with none of the above gets a_default. When reading
+  // it is told by content, a package document is always an object and the first byte of one differs in each.
+  static Format formatFor(std::string const &a_filename, Format const a_default = Format::eJson);
+  static Format detect(std::string const &a_filename);
+
+  static bool read(std::string const &a_filename, Json &a_json);
+  // Like root() for any format. Elements and connections of a text package are stepped over without parsing them.
+  static bool readRoot(std::string const &a_filename, Json &a_json);
+  static bool write(std::string const &a_filename, Json const &a_json, Format const a_format);
+  static std::vector<uint8_t> encode(Json const &a_json);
+  static bool convert(std::string const &a_from, std::string const &a_to);
+
+  bool open(std::string const &a_filename);
+  void close();
+  bool isOpen() const { return m_data != nullptr; }
+
+  // The root package without its elements and connections, or the whole document if it was stored as CBOR.
+  Json root() const;
+  size_t elementsCount() const;
+  Json element(size_t const a_index) const;
+  size_t connectionsCount() const;
+  Connection connection(size_t const a_index) const;
+
+  Json toJson() const;
+
+ private:
+  std::string_view string(uint32_t const a_index) const;
+  Json record(size_t const a_index) const;
+  Json blob(uint64_t const a_offset, uint64_t const a_size) const;
+
+ private:
+  uint8_t const *m_data{};
+  size_t m_size{};
+  std::vector<uint8_t> m_buffer{};
+  bool m_mapped{};
+};
+
+} // namespace spaghetti
+
+#endif // SPAGHETTI_PACKAGE_FILE_H
@@ -0,0 +1,71 @@
+// MIT License
+//
+// Copyright (c) 2017-2018 Artur Wyszyński, aljen at hitomi dot pl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+#ifndef SPAGHETTI_PACKAGE_JOURNAL_H
+#define SPAGHETTI_PACKAGE_JOURNAL_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <spaghetti/api.h>
+#include <spaghetti/element.h>
+
+namespace spaghetti {
+
+// Append-only log of the edits saved since a package file was last written in full, kept next to it. Each line is
+// a Json entry: the fingerprint of the file it belongs to first, then one batch per save closed by a commit line.
+// Entries refer to elements by their position in the file, elements added later get positions past its end:
+//
+//   {"set": <element>}               element added or changed, its "id" is the position
+//   {"remove": <id>}                 element removed along with its connections
+//   {"connect": [from, socket, to, socket]}
+//   {"disconnect": [from, socket, to, socket]}
+//   {"header": <package>}            package properties, without elements and connections
+//   {"commit": <entries>}
+//
+// A batch cut short by a crash is dropped when replaying, a journal whose fingerprint doesn't match the file (left
+// over when the file was rewritten) is ignored.
+class SPAGHETTI_API PackageJournal final {
+ public:
+  using Json = Element::Json;
+
+  static constexpr char const *const EXTENSION{ ".journal" };
+
+  static std::string filenameFor(std::string const &a_base) { return a_base + EXTENSION; }
+
+  static uint64_t fingerprint(std::string const &a_base);
+
+  // Starts an empty journal for a_base, replacing whatever was there.
+  static bool start(std::string const &a_base);
+  static bool append(std::string const &a_base, std::vector<Json> const &a_entries);
+  static size_t size(std::string const &a_base);
+
+  // Reads a_base into a_root with its journal applied, false without a (matching) journal.
+  static bool replay(std::string const &a_base, Json &a_root);
+};
+
+} // namespace spaghetti
+
+#endif // SPAGHETTI_PACKAGE_JOURNAL_H
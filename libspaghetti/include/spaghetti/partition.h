@@ -0,0 +1,101 @@
+// MIT License
+//
+// Copyright (c) 2017-2018 Artur Wyszyński, aljen at hitomi dot pl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#ifndef SPAGHETTI_PARTITION_H
+#define SPAGHETTI_PARTITION_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <spaghetti/api.h>
+#include <spaghetti/element.h>
+
+namespace spaghetti {
+
+class Package;
+
+// Runs one part of a simulation split across processes. The cut edges are the root package's
+// inputs and outputs: every tick each part sends its outputs and waits for the others', a remote
+// output is fed into the local input with the same name and type. Waiting for every peer's frame of the
+// current tick acts as the barrier, so values crossing the cut arrive one tick late.
+//
+// Parts are connected as a star around the listening one. It relays what every connected part
+// sent to all the others, along with its own outputs, and reports outputs no other part reads.
+//
+// Addresses are "unix:<path>" or "tcp:[<host>:]<port>", the host defaults to loopback.
+class SPAGHETTI_API Partition final {
+ public:
+  using duration_t = Element::duration_t;
+
+  // A root package input or output as announced to the other parts.
+  struct Socket {
+    std::string name{};
+    ValueType type{};
+  };
+  using Sockets = std::vector<Socket>;
+
+  explicit Partition(Package *const a_package);
+  ~Partition();
+
+  Partition(Partition const &) = delete;
+  Partition &operator=(Partition const &) = delete;
+
+  bool listen(std::string const &a_address, size_t const a_peers = 1);
+  bool connect(std::string const &a_address);
+  void close();
+
+  bool step(duration_t const &a_delta);
+  bool runFor(duration_t const &a_time, duration_t const &a_step = duration_t{ 1.0 });
+
+  uint64_t tick() const { return m_tick; }
+  size_t peers() const { return m_peers.size(); }
+
+ private:
+  struct Peer {
+    int socket{ -1 };
+    Sockets outputs{};
+    Sockets inputs{};
+    std::vector<int16_t> routes{};
+    std::vector<uint8_t> values{};
+  };
+
+  bool sendSockets(Peer const &a_peer, Sockets const &a_outputs, Sockets const &a_inputs);
+  bool receiveSockets(Peer &a_peer);
+  void checkRoutes() const;
+  bool sendFrame(Peer const &a_peer, std::vector<uint8_t> const &a_values, size_t const a_count);
+  bool receiveFrame(Peer &a_peer);
+  bool exchange();
+
+ private:
+  Package *const m_package{};
+  std::vector<Peer> m_peers{};
+  std::vector<uint8_t> m_buffer{};
+  std::vector<uint8_t> m_values{};
+  uint64_t m_tick{};
+  bool m_relay{};
+};
+
+} // namespace spaghetti
+
+#endif // SPAGHETTI_PARTITION_H
@@ -43,6 +43,7 @@ namespace spaghetti {
 
 class Element;
 class Node;
+class Package;
 
 class SPAGHETTI_API Registry final {
   struct MetaInfo {
@@ -52,8 +53,10 @@ class SPAGHETTI_API Registry final {
     std::string icon{};
     template<typename T>
     using CloneFunc = T *(*)();
+    using CopyFunc = Element *(*)(Element const &);
     CloneFunc<Element> cloneElement{};
     CloneFunc<Node> cloneNode{};
+    CopyFunc copyElement{};
   };
 
  public:
@@ -77,18 +80,20 @@ class SPAGHETTI_API Registry final {
   registerElement(std::string a_name, std::string a_icon)
   {
     string::hash_t const hash{ ElementDerived::HASH };
-    assert(!hasElement(hash));
     MetaInfo info{ hash,
                    ElementDerived::TYPE,
                    std::move(a_name),
                    std::move(a_icon),
                    &cloneElement<ElementDerived>,
-                   &cloneNode<NodeDerived> };
+                   &cloneNode<NodeDerived>,
+                   &copyElement<ElementDerived> };
     addElement(info);
   }
 
   Element *createElement(char const *const a_name) { return createElement(string::hash(a_name)); }
   Element *createElement(string::hash_t const a_hash);
+  // Copy constructs an element of the same type, nullptr if that type isn't copy constructible.
+  Element *createElementCopy(Element const &a_element);
 
   Node *createNode(char const *const a_name) { return createNode(string::hash(a_name)); }
   Node *createNode(string::hash_t const a_hash);
@@ -100,6 +105,8 @@ class SPAGHETTI_API Registry final {
   std::string elementIcon(string::hash_t const a_hash);
 
   bool hasElement(string::hash_t const a_hash) const;
+  // Changes whenever the set of registered element types does, whatever order they were registered in.
+  uint64_t elementsSignature() const;
 
   size_t size() const;
   MetaInfo const &metaInfoFor(string::hash_t const a_hash) const;
@@ -107,12 +114,19 @@ class SPAGHETTI_API Registry final {
 
   Packages const &packages() const;
 
+  // Fully built package registered under a_path, loaded on first use and cloned by every external instance.
+  Package const *packagePrototype(std::string const &a_path);
+
   std::string appPath() const;
   std::string systemPluginsPath() const;
   std::string userPluginsPath() const;
   std::string systemPackagesPath() const;
   std::string userPackagesPath() const;
 
+  // Directory packages keep their execution plans in between runs, plans aren't cached while it's empty.
+  std::string planCachePath() const;
+  void setPlanCachePath(std::string const &a_path);
+
  private:
   Registry();
 
@@ -124,6 +138,15 @@ class SPAGHETTI_API Registry final {
     return new T;
   }
 
+  template<typename T>
+  static Element *copyElement(Element const &a_element)
+  {
+    if constexpr (std::is_copy_constructible_v<T>)
+      return new T(static_cast<T const &>(a_element));
+    else
+      return nullptr;
+  }
+
   template<typename T>
   static Node *cloneNode()
   {
@@ -0,0 +1,211 @@
+// MIT License
+//
+// Copyright (c) 2017-2018 Artur Wyszyński, aljen at hitomi dot pl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+#ifndef SPAGHETTI_SMALL_VECTOR_H
+#define SPAGHETTI_SMALL_VECTOR_H
+
+#include <cassert>
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace spaghetti {
+
+// Vector keeping up to N items inline, so elements with typical socket counts don't touch the heap for them.
+// Only the subset of std::vector used by the library is provided, iterators are plain pointers.
+template<typename T, size_t N>
+class SmallVector final {
+ public:
+  using value_type = T;
+  using size_type = size_t;
+  using reference = T &;
+  using const_reference = T const &;
+  using iterator = T *;
+  using const_iterator = T const *;
+
+  SmallVector() = default;
+
+  SmallVector(std::initializer_list<T> a_items)
+  {
+    reserve(a_items.size());
+    for (auto const &ITEM : a_items) emplace_back(ITEM);
+  }
+
+  SmallVector(SmallVector const &a_other)
+  {
+    reserve(a_other.m_size);
+    for (auto const &ITEM : a_other) emplace_back(ITEM);
+  }
+
+  SmallVector(SmallVector &&a_other) noexcept(std::is_nothrow_move_constructible_v<T>) { steal(a_other); }
+
+  ~SmallVector()
+  {
+    clear();
+    release();
+  }
+
+  SmallVector &operator=(SmallVector const &a_other)
+  {
+    if (this == &a_other) return *this;
+
+    clear();
+    reserve(a_other.m_size);
+    for (auto const &ITEM : a_other) emplace_back(ITEM);
+    return *this;
+  }
+
+  SmallVector &operator=(SmallVector &&a_other) noexcept(std::is_nothrow_move_constructible_v<T>)
+  {
+    if (this == &a_other) return *this;
+
+    clear();
+    release();
+    steal(a_other);
+    return *this;
+  }
+
+  size_t size() const noexcept { return m_size; }
+  size_t capacity() const noexcept { return m_capacity; }
+  bool empty() const noexcept { return m_size == 0; }
+  bool isInline() const noexcept { return m_data == inlineData(); }
+
+  T *data() noexcept { return m_data; }
+  T const *data() const noexcept { return m_data; }
+
+  T &operator[](size_t const a_index)
+  {
+    assert(a_index < m_size);
+    return m_data[a_index];
+  }
+  T const &operator[](size_t const a_index) const
+  {
+    assert(a_index < m_size);
+    return m_data[a_index];
+  }
+
+  T &front() { return (*this)[0]; }
+  T const &front() const { return (*this)[0]; }
+  T &back() { return (*this)[m_size - 1]; }
+  T const &back() const { return (*this)[m_size - 1]; }
+
+  iterator begin() noexcept { return m_data; }
+  iterator end() noexcept { return m_data + m_size; }
+  const_iterator begin() const noexcept { return m_data; }
+  const_iterator end() const noexcept { return m_data + m_size; }
+  const_iterator cbegin() const noexcept { return m_data; }
+  const_iterator cend() const noexcept { return m_data + m_size; }
+
+  void reserve(size_t const a_capacity)
+  {
+    if (a_capacity <= m_capacity) return;
+
+    auto const data = static_cast<T *>(::operator new(a_capacity * sizeof(T)));
+    for (size_t i = 0; i < m_size; ++i) {
+      new (data + i) T{ std::move(m_data[i]) };
+      m_data[i].~T();
+    }
+
+    release();
+    m_data = data;
+    m_capacity = a_capacity;
+  }
+
+  template<typename... Args>
+  T &emplace_back(Args &&... a_args)
+  {
+    if (m_size == m_capacity) {
+      // The arguments may refer to our own items, build the new one before they move.
+      T item{ std::forward<Args>(a_args)... };
+      reserve(m_capacity * 2);
+      return emplaceUnchecked(std::move(item));
+    }
+
+    return emplaceUnchecked(std::forward<Args>(a_args)...);
+  }
+
+  void push_back(T const &a_item) { emplace_back(a_item); }
+  void push_back(T &&a_item) { emplace_back(std::move(a_item)); }
+
+  void pop_back()
+  {
+    assert(m_size > 0);
+    m_data[--m_size].~T();
+  }
+
+  void clear() noexcept
+  {
+    while (m_size > 0) m_data[--m_size].~T();
+  }
+
+ private:
+  T *inlineData() noexcept { return reinterpret_cast<T *>(&m_storage); }
+  T const *inlineData() const noexcept { return reinterpret_cast<T const *>(&m_storage); }
+
+  template<typename... Args>
+  T &emplaceUnchecked(Args &&... a_args)
+  {
+    auto const item = new (m_data + m_size) T{ std::forward<Args>(a_args)... };
+    m_size++;
+    return *item;
+  }
+
+  void release() noexcept
+  {
+    if (!isInline()) ::operator delete(m_data);
+    m_data = inlineData();
+    m_capacity = N;
+  }
+
+  void steal(SmallVector &a_other)
+  {
+    if (a_other.isInline()) {
+      for (auto &&item : a_other) emplace_back(std::move(item));
+      a_other.clear();
+      return;
+    }
+
+    m_data = a_other.m_data;
+    m_size = a_other.m_size;
+    m_capacity = a_other.m_capacity;
+    a_other.m_data = a_other.inlineData();
+    a_other.m_size = 0;
+    a_other.m_capacity = N;
+  }
+
+ private:
+  static_assert(N > 0, "SmallVector needs room for at least one inline item");
+
+  std::aligned_storage_t<sizeof(T) * N, alignof(T)> m_storage;
+  T *m_data{ inlineData() };
+  size_t m_size{};
+  size_t m_capacity{ N };
+};
+
+} // namespace spaghetti
+
+#endif // SPAGHETTI_SMALL_VECTOR_H
@@ -0,0 +1,138 @@
+// MIT License
+//
+// Copyright (c) 2017-2018 Artur Wyszyński, aljen at hitomi dot pl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+#ifndef SPAGHETTI_STATE_H
+#define SPAGHETTI_STATE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+namespace spaghetti {
+
+// Raw byte streams for the runtime state elements keep besides their sockets, see Element::saveState().
+// Values are copied as they are in memory, a checkpoint is only meant to be restored by the same build.
+class StateWriter final {
+ public:
+  explicit StateWriter(std::vector<uint8_t> &a_buffer)
+    : m_buffer{ a_buffer }
+  {
+  }
+
+  template<typename T>
+  void write(T const &a_value)
+  {
+    static_assert(std::is_trivially_copyable_v<T>, "Only plain values can be written");
+
+    size_t const OFFSET{ m_buffer.size() };
+    m_buffer.resize(OFFSET + sizeof(T));
+    std::memcpy(m_buffer.data() + OFFSET, &a_value, sizeof(T));
+  }
+
+  template<typename T, typename... Args>
+  void write(T const &a_value, Args const &... a_values)
+  {
+    write(a_value);
+    write(a_values...);
+  }
+
+  // Length prefixed block, StateReader::block() hands it out as a reader of its own.
+  size_t beginBlock()
+  {
+    size_t const OFFSET{ m_buffer.size() };
+    write(uint32_t{});
+    return OFFSET;
+  }
+
+  void endBlock(size_t const a_block)
+  {
+    auto const SIZE = static_cast<uint32_t>(m_buffer.size() - a_block - sizeof(uint32_t));
+    std::memcpy(m_buffer.data() + a_block, &SIZE, sizeof(SIZE));
+  }
+
+ private:
+  std::vector<uint8_t> &m_buffer;
+};
+
+class StateReader final {
+ public:
+  StateReader(uint8_t const *const a_data, size_t const a_size)
+    : m_data{ a_data }
+    , m_size{ a_size }
+  {
+  }
+
+  // Reading past the end leaves the value untouched and marks the reader as failed.
+  template<typename T>
+  void read(T &a_value)
+  {
+    static_assert(std::is_trivially_copyable_v<T>, "Only plain values can be read");
+
+    if (m_size - m_offset < sizeof(T)) {
+      m_failed = true;
+      return;
+    }
+
+    std::memcpy(&a_value, m_data + m_offset, sizeof(T));
+    m_offset += sizeof(T);
+  }
+
+  template<typename T, typename... Args>
+  void read(T &a_value, Args &... a_values)
+  {
+    read(a_value);
+    read(a_values...);
+  }
+
+  StateReader block()
+  {
+    uint32_t size{};
+    read(size);
+    if (m_failed || m_size - m_offset < size) {
+      m_failed = true;
+      m_offset = m_size;
+      return StateReader{ nullptr, 0 };
+    }
+
+    StateReader block{ m_data + m_offset, size };
+    m_offset += size;
+    return block;
+  }
+
+  size_t left() const { return m_size - m_offset; }
+  bool failed() const { return m_failed; }
+  void fail() { m_failed = true; }
+
+ private:
+  uint8_t const *m_data{};
+  size_t m_size{};
+  size_t m_offset{};
+  bool m_failed{};
+};
+
+} // namespace spaghetti
+
+#endif // SPAGHETTI_STATE_H
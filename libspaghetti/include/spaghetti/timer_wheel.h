@@ -0,0 +1,119 @@
+// MIT License
+//
+// Copyright (c) 2017-2018 Artur Wyszyński, aljen at hitomi dot pl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+#ifndef SPAGHETTI_TIMER_WHEEL_H
+#define SPAGHETTI_TIMER_WHEEL_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+#include <spaghetti/api.h>
+
+namespace spaghetti {
+
+// Hierarchical timing wheel with 1 ms resolution, owned by the root package and advanced by its dispatch thread.
+// Scheduling and cancelling are O(1) and may happen from package worker threads, advancing is done by the
+// dispatch thread while workers are idle and expired timers are called back before the next calculate().
+class SPAGHETTI_API TimerWheel final {
+ public:
+  using duration_t = std::chrono::duration<double, std::milli>;
+  using Callback = std::function<void()>;
+
+  class SPAGHETTI_API Timer final {
+   public:
+    Timer() = default;
+    ~Timer() { cancel(); }
+
+    // Copies start out inactive, a scheduled callback belongs to whoever armed the original.
+    Timer(Timer const &) {}
+    Timer &operator=(Timer const &a_other)
+    {
+      if (this != &a_other) cancel();
+      return *this;
+    }
+
+    bool isActive() const { return m_wheel != nullptr; }
+    void cancel();
+
+    // Time until the callback fires, duration_t::max() when the timer isn't armed.
+    duration_t timeLeft() const;
+
+   private:
+    friend class TimerWheel;
+    TimerWheel *m_wheel{};
+    Timer *m_previous{};
+    Timer *m_next{};
+    uint64_t m_expiry{};
+    uint8_t m_level{};
+    uint8_t m_slot{};
+    Callback m_callback{};
+  };
+
+  TimerWheel() = default;
+  ~TimerWheel();
+
+  TimerWheel(TimerWheel const &) = delete;
+  TimerWheel &operator=(TimerWheel const &) = delete;
+
+  void schedule(Timer &a_timer, duration_t const &a_timeout, Callback a_callback);
+  void advance(duration_t const &a_delta);
+
+  // Cancels every armed timer and moves the clock to a_now, used when restoring a simulation checkpoint.
+  void reset(duration_t const &a_now);
+
+  duration_t now() const { return duration_t{ static_cast<double>(m_now) } + m_remainder; }
+  duration_t timeToNextExpiry() const;
+  size_t size() const { return m_size; }
+
+ private:
+  static constexpr size_t SLOT_BITS{ 6 };
+  static constexpr size_t SLOTS{ 1 << SLOT_BITS };
+  static constexpr uint64_t SLOT_MASK{ SLOTS - 1 };
+  static constexpr size_t LEVELS{ 4 };
+
+  struct Level {
+    std::array<Timer *, SLOTS> slots{};
+    uint64_t occupied{};
+  };
+
+  void insert(Timer &a_timer);
+  void remove(Timer &a_timer);
+  void unlink(Timer &a_timer);
+  void cascade(size_t const a_level);
+  void expire();
+
+ private:
+  std::array<Level, LEVELS> m_levels{};
+  uint64_t m_now{};
+  duration_t m_remainder{};
+  size_t m_size{};
+  std::mutex m_mutex{};
+};
+
+} // namespace spaghetti
+
+#endif // SPAGHETTI_TIMER_WHEEL_H
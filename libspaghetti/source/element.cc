@@ -26,14 +26,63 @@
 #include <iostream>
 
 #include "spaghetti/package.h"
+#include "spaghetti/registry.h"
+#include "slab.h"
 
 namespace spaghetti {
 
+void *Element::operator new(size_t const a_size)
+{
+  return Slab::get().allocate(a_size);
+}
+
+void Element::operator delete(void *const a_pointer, size_t const a_size) noexcept
+{
+  Slab::get().deallocate(a_pointer, a_size);
+}
+
+Element::Element(Element const &a_other)
+  : m_inputs{ a_other.m_inputs }
+  , m_outputs{ a_other.m_outputs }
+  , m_minInputs{ a_other.m_minInputs }
+  , m_maxInputs{ a_other.m_maxInputs }
+  , m_minOutputs{ a_other.m_minOutputs }
+  , m_maxOutputs{ a_other.m_maxOutputs }
+  , m_defaultNewInputFlags{ a_other.m_defaultNewInputFlags }
+  , m_defaultNewOutputFlags{ a_other.m_defaultNewOutputFlags }
+{
+  if (!a_other.m_metadata) return;
+
+  if (!a_other.m_metadata->handler && !a_other.m_metadata->node) {
+    m_metadata = a_other.m_metadata;
+    return;
+  }
+
+  auto &metadata = this->metadata();
+  metadata.name = a_other.m_metadata->name;
+  metadata.position = a_other.m_metadata->position;
+  metadata.isIconified = a_other.m_metadata->isIconified;
+  metadata.iconifyingHidesCentralWidget = a_other.m_metadata->iconifyingHidesCentralWidget;
+}
+
+Element *Element::clone() const
+{
+  auto &registry = Registry::get();
+  if (auto const copy = registry.createElementCopy(*this)) return copy;
+
+  // Types that can't be copy constructed go through their serialized form.
+  Json json{};
+  const_cast<Element *>(this)->serialize(json);
+  auto const copy = registry.createElement(hash());
+  copy->deserialize(json);
+  return copy;
+}
+
 void Element::serialize(Element::Json &a_json)
 {
   auto &jsonElement = a_json["element"];
   jsonElement["id"] = m_id;
-  jsonElement["name"] = m_name;
+  jsonElement["name"] = name();
   jsonElement["type"] = type();
   jsonElement["min_inputs"] = m_minInputs;
   jsonElement["max_inputs"] = m_maxInputs;
@@ -78,17 +127,17 @@ void Element::serialize(Element::Json &a_json)
   jsonIo["inputs"] = jsonInputs;
   jsonIo["outputs"] = jsonOutputs;
 
+  auto const &POSITION = position();
   auto &jsonNode = a_json["node"];
-  jsonNode["position"]["x"] = m_position.x;
-  jsonNode["position"]["y"] = m_position.y;
-  jsonNode["iconify"] = m_isIconified;
-  jsonNode["iconifying_hides_central_widget"] = m_iconifyingHidesCentralWidget;
+  jsonNode["position"]["x"] = POSITION.x;
+  jsonNode["position"]["y"] = POSITION.y;
+  jsonNode["iconify"] = isIconified();
+  jsonNode["iconifying_hides_central_widget"] = iconifyingHidesCentralWidget();
 }
 
 void Element::deserialize(Json const &a_json)
 {
   auto const &ELEMENT = a_json["element"];
-  auto const NAME = ELEMENT["name"].get<std::string>();
   auto const MIN_INPUTS = ELEMENT["min_inputs"].get<uint8_t>();
   auto const MAX_INPUTS = ELEMENT["max_inputs"].get<uint8_t>();
   auto const MIN_OUTPUTS = ELEMENT["min_outputs"].get<uint8_t>();
@@ -100,15 +149,21 @@ void Element::deserialize(Json const &a_json)
   auto const &INPUTS = IO["inputs"];
   auto const &OUTPUTS = IO["outputs"];
 
-  auto const &NODE = a_json["node"];
-  auto const ICONIFY = NODE["iconify"].get<bool>();
-  auto const ICONIFYING_HIDES_CENTRAL_WIDGET = NODE["iconifying_hides_central_widget"].get<bool>();
-  auto const &POSITION = NODE["position"];
-  auto const POSITION_X = POSITION["x"].get<double>();
-  auto const POSITION_Y = POSITION["y"].get<double>();
+  if (!m_package || !m_package->isHeadless()) {
+    auto const NAME = ELEMENT["name"].get<std::string>();
+    auto const &NODE = a_json["node"];
+    auto const ICONIFY = NODE["iconify"].get<bool>();
+    auto const ICONIFYING_HIDES_CENTRAL_WIDGET = NODE["iconifying_hides_central_widget"].get<bool>();
+    auto const &POSITION = NODE["position"];
+    auto const POSITION_X = POSITION["x"].get<double>();
+    auto const POSITION_Y = POSITION["y"].get<double>();
+
+    setName(NAME);
+    setPosition(POSITION_X, POSITION_Y);
+    iconify(ICONIFY);
+    setIconifyingHidesCentralWidget(ICONIFYING_HIDES_CENTRAL_WIDGET);
+  }
 
-  setName(NAME);
-  setPosition(POSITION_X, POSITION_Y);
   clearInputs();
   clearOutputs();
   setMinInputs(MIN_INPUTS);
@@ -117,8 +172,6 @@ void Element::deserialize(Json const &a_json)
   setMaxOutputs(MAX_OUTPUTS);
   setDefaultNewInputFlags(DEFAULT_NEW_INPUT_FLAGS);
   setDefaultNewOutputFlags(DEFAULT_NEW_OUTPUT_FLAGS);
-  iconify(ICONIFY);
-  setIconifyingHidesCentralWidget(ICONIFYING_HIDES_CENTRAL_WIDGET);
 
   auto add_socket = [&](Json const &a_socket, bool const a_input, uint8_t &a_socketCount) {
     auto const SOCKET_ID = a_socket["socket"].get<uint8_t>();
@@ -150,8 +203,9 @@ void Element::deserialize(Json const &a_json)
 
 void Element::setName(std::string const &a_name)
 {
-  auto const OLD_NAME = m_name;
-  m_name = a_name;
+  auto &name = metadata().name;
+  auto const OLD_NAME = name;
+  name = a_name;
 
   handleEvent(Event{ EventType::eElementNameChanged, EventNameChanged{ OLD_NAME, a_name } });
 }
@@ -193,6 +247,7 @@ void Element::removeInput()
 void Element::clearInputs()
 {
   m_inputs.clear();
+  touch();
 }
 
 bool Element::addOutput(ValueType const a_type, std::string const &a_name, uint8_t const a_flags)
@@ -232,6 +287,7 @@ void Element::removeOutput()
 void Element::clearOutputs()
 {
   m_outputs.clear();
+  touch();
 }
 
 void Element::setIOName(bool const a_input, uint8_t const a_id, std::string const &a_name)
@@ -269,34 +325,76 @@ void Element::resetIOSocketValue(IOSocket &a_io)
   }
 }
 
+void Element::wakeUp()
+{
+  touch();
+  if (m_package) m_package->wakeDispatchThread();
+}
+
+void Element::touch()
+{
+  m_revision.fetch_add(1, std::memory_order_relaxed);
+
+  // A change inside an inline or external package changes the package element too, the root has no snapshot copy.
+  for (Element *package = m_package; package && package->m_package; package = package->m_package)
+    package->m_revision.fetch_add(1, std::memory_order_relaxed);
+}
+
 void Element::handleEvent(Event const &a_event)
 {
+  touch();
   onEvent(a_event);
-  if (m_handler) m_handler(a_event);
+  if (m_metadata && m_metadata->handler) m_metadata->handler(a_event);
+}
+
+Element::vec2d const &Element::position() const
+{
+  static vec2d const s_origin{};
+  return m_metadata ? m_metadata->position : s_origin;
+}
+
+Element::Metadata &Element::metadata()
+{
+  if (!m_metadata)
+    m_metadata = std::make_shared<Metadata>();
+  else if (m_metadata.use_count() > 1)
+    m_metadata = std::make_shared<Metadata>(*m_metadata);
+  touch();
+  return *m_metadata;
+}
+
+uint64_t Element::nextSerial()
+{
+  static std::atomic<uint64_t> s_serial{};
+  return ++s_serial;
 }
 
 void Element::setMinInputs(uint8_t const a_min)
 {
   if (a_min > m_maxInputs) return;
   m_minInputs = a_min;
+  touch();
 }
 
 void Element::setMaxInputs(uint8_t const a_max)
 {
   if (a_max < m_minInputs) return;
   m_maxInputs = a_max;
+  touch();
 }
 
 void Element::setMinOutputs(uint8_t const a_min)
 {
   if (a_min > m_maxOutputs) return;
   m_minOutputs = a_min;
+  touch();
 }
 
 void Element::setMaxOutputs(uint8_t const a_max)
 {
   if (a_max < m_minOutputs) return;
   m_maxOutputs = a_max;
+  touch();
 }
 
 } // namespace spaghetti
@@ -21,6 +21,7 @@
 // SOFTWARE.
 
 #include <spaghetti/elements/logic/blinker.h>
+#include <spaghetti/package.h>
 
 namespace spaghetti::elements::logic {
 
@@ -38,20 +39,6 @@ Blinker::Blinker()
   addOutput(ValueType::eBool, "State", IOSocket::eCanHoldBool);
 }
 
-void Blinker::update(duration_t const &a_delta)
-{
-  if (m_enabled) {
-    m_time += a_delta;
-
-    auto const RATE = m_state ? m_highRate : m_lowRate;
-    if (m_time >= RATE) {
-      m_time = duration_t{};
-      m_state = !m_state;
-      m_outputs[0].value = m_state;
-    }
-  }
-}
-
 void Blinker::calculate()
 {
   bool const ENABLED = std::get<bool>(m_inputs[0].value);
@@ -68,10 +55,39 @@ void Blinker::calculate()
   m_lowRate = LOW_RATE;
 
   if (changed) {
-    m_time = duration_t{};
     m_state = false;
     m_outputs[0].value = m_state;
+
+    if (m_enabled)
+      schedule(m_lowRate);
+    else
+      m_timer.cancel();
   }
 }
 
+void Blinker::saveState(StateWriter &a_state) const
+{
+  a_state.write(m_enabled, m_state, m_highRate, m_lowRate, m_timer.timeLeft());
+}
+
+void Blinker::loadState(StateReader &a_state)
+{
+  duration_t timeLeft{ duration_t::max() };
+  a_state.read(m_enabled, m_state, m_highRate, m_lowRate, timeLeft);
+
+  if (timeLeft != duration_t::max())
+    schedule(timeLeft);
+  else
+    m_timer.cancel();
+}
+
+void Blinker::schedule(duration_t const &a_timeout)
+{
+  m_package->timerWheel().schedule(m_timer, a_timeout, [this] {
+    m_state = !m_state;
+    m_outputs[0].value = m_state;
+    schedule(m_state ? m_highRate : m_lowRate);
+  });
+}
+
 } // namespace spaghetti::elements::logic
@@ -61,4 +61,14 @@ void CounterDown::calculate()
   m_lastLoad = LOAD;
 }
 
+void CounterDown::saveState(StateWriter &a_state) const
+{
+  a_state.write(m_preset, m_current, m_state, m_lastCD, m_lastLoad);
+}
+
+void CounterDown::loadState(StateReader &a_state)
+{
+  a_state.read(m_preset, m_current, m_state, m_lastCD, m_lastLoad);
+}
+
 } // namespace spaghetti::elements::logic
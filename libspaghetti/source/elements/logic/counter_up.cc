@@ -61,4 +61,14 @@ void CounterUp::calculate()
   m_lastReset = RESET;
 }
 
+void CounterUp::saveState(StateWriter &a_state) const
+{
+  a_state.write(m_preset, m_current, m_state, m_lastCU, m_lastReset);
+}
+
+void CounterUp::loadState(StateReader &a_state)
+{
+  a_state.read(m_preset, m_current, m_state, m_lastCU, m_lastReset);
+}
+
 } // namespace spaghetti::elements::logic
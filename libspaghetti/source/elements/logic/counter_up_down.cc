@@ -79,4 +79,14 @@ void CounterUpDown::calculate()
   m_lastLoad = LOAD;
 }
 
+void CounterUpDown::saveState(StateWriter &a_state) const
+{
+  a_state.write(m_preset, m_current, m_stateCD, m_stateCU, m_lastCD, m_lastCU, m_lastReset, m_lastLoad);
+}
+
+void CounterUpDown::loadState(StateReader &a_state)
+{
+  a_state.read(m_preset, m_current, m_stateCD, m_stateCU, m_lastCD, m_lastCU, m_lastReset, m_lastLoad);
+}
+
 } // namespace spaghetti::elements::logic
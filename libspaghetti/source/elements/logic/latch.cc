@@ -48,4 +48,14 @@ void Latch ::calculate()
   m_lastValue = INPUT;
 }
 
+void Latch::saveState(StateWriter &a_state) const
+{
+  a_state.write(m_lastValue, m_state);
+}
+
+void Latch::loadState(StateReader &a_state)
+{
+  a_state.read(m_lastValue, m_state);
+}
+
 } // namespace spaghetti::elements::logic
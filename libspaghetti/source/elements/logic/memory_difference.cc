@@ -51,4 +51,14 @@ void MemoryDifference ::calculate()
   m_outputs[1].value = m_lastValue;
 }
 
+void MemoryDifference::saveState(StateWriter &a_state) const
+{
+  a_state.write(m_currentValue, m_lastValue);
+}
+
+void MemoryDifference::loadState(StateReader &a_state)
+{
+  a_state.read(m_currentValue, m_lastValue);
+}
+
 } // namespace spaghetti::elements::logic
@@ -61,18 +61,34 @@ void PID::calculate()
 
   float const ERROR{ SP - PV };
 
-  if (!nearly_equal(KI, 0.0f)) m_integral += (ERROR * m_delta) / KI;
-  m_integral = std::clamp(m_integral, CV_LOW, CV_HIGH);
+  // Passes without time passing (settling after an event) keep the integral and derivative of the last step.
+  if (m_delta > 0.0f) {
+    float const LAST_INTEGRAL{ m_integral };
+    if (!nearly_equal(KI, 0.0f)) m_integral += (ERROR * m_delta) / KI;
+    m_integral = std::clamp(m_integral, CV_LOW, CV_HIGH);
+    m_derivative = KD * ((ERROR - m_lastError) / m_delta);
+
+    m_steady = nearly_equal(LAST_INTEGRAL, m_integral) && nearly_equal(ERROR, m_lastError);
+    m_lastError = ERROR;
+  }
 
   float const P{ KP * ERROR };
   float const I{ m_integral };
-  float const D{ KD * ((ERROR - m_lastError) / m_delta) };
+  float const D{ m_derivative };
 
   float const CV{ std::clamp(P + I + D, CV_LOW, CV_HIGH) };
 
-  m_lastError = ERROR;
-
   m_outputs[0].value = CV;
 }
 
+void PID::saveState(StateWriter &a_state) const
+{
+  a_state.write(m_steady, m_delta, m_integral, m_derivative, m_lastError);
+}
+
+void PID::loadState(StateReader &a_state)
+{
+  a_state.read(m_steady, m_delta, m_integral, m_derivative, m_lastError);
+}
+
 } // namespace spaghetti::elements::logic
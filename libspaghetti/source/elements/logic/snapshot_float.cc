@@ -48,4 +48,14 @@ void SnapshotFloat::calculate()
   m_outputs[0].value = m_value;
 }
 
+void SnapshotFloat::saveState(StateWriter &a_state) const
+{
+  a_state.write(m_value);
+}
+
+void SnapshotFloat::loadState(StateReader &a_state)
+{
+  a_state.read(m_value);
+}
+
 } // namespace spaghetti::elements::logic
@@ -48,4 +48,14 @@ void SnapshotInt::calculate()
   m_outputs[0].value = m_value;
 }
 
+void SnapshotInt::saveState(StateWriter &a_state) const
+{
+  a_state.write(m_value);
+}
+
+void SnapshotInt::loadState(StateReader &a_state)
+{
+  a_state.read(m_value);
+}
+
 } // namespace spaghetti::elements::logic
@@ -58,4 +58,14 @@ void TriggerFalling::calculate()
   m_lastValue = INPUT;
 }
 
+void TriggerFalling::saveState(StateWriter &a_state) const
+{
+  a_state.write(m_state, m_lastValue);
+}
+
+void TriggerFalling::loadState(StateReader &a_state)
+{
+  a_state.read(m_state, m_lastValue);
+}
+
 } // namespace spaghetti::elements::logic
@@ -58,4 +58,14 @@ void TriggerRising::calculate()
   m_lastValue = INPUT;
 }
 
+void TriggerRising::saveState(StateWriter &a_state) const
+{
+  a_state.write(m_state, m_lastValue);
+}
+
+void TriggerRising::loadState(StateReader &a_state)
+{
+  a_state.read(m_state, m_lastValue);
+}
+
 } // namespace spaghetti::elements::logic
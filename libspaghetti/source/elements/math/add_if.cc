@@ -61,4 +61,14 @@ void AddIf::calculate()
   m_outputs[0].value = sum;
 }
 
+void AddIf::saveState(StateWriter &a_state) const
+{
+  a_state.write(m_enabled);
+}
+
+void AddIf::loadState(StateReader &a_state)
+{
+  a_state.read(m_enabled);
+}
+
 } // namespace spaghetti::elements::math
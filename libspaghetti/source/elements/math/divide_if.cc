@@ -72,4 +72,14 @@ void DivideIf::calculate()
   m_outputs[0].value = output;
 }
 
+void DivideIf::saveState(StateWriter &a_state) const
+{
+  a_state.write(m_enabled);
+}
+
+void DivideIf::loadState(StateReader &a_state)
+{
+  a_state.read(m_enabled);
+}
+
 } // namespace spaghetti::elements::math
@@ -64,4 +64,14 @@ void MultiplyIf::calculate()
   m_outputs[0].value = output;
 }
 
+void MultiplyIf::saveState(StateWriter &a_state) const
+{
+  a_state.write(m_enabled);
+}
+
+void MultiplyIf::loadState(StateReader &a_state)
+{
+  a_state.read(m_enabled);
+}
+
 } // namespace spaghetti::elements::math
@@ -60,4 +60,14 @@ void SubtractIf::calculate()
   m_outputs[0].value = ret;
 }
 
+void SubtractIf::saveState(StateWriter &a_state) const
+{
+  a_state.write(m_enabled);
+}
+
+void SubtractIf::loadState(StateReader &a_state)
+{
+  a_state.read(m_enabled);
+}
+
 } // namespace spaghetti::elements::math
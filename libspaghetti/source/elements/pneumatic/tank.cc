@@ -64,11 +64,19 @@ void Tank::deserialize(Json const &a_json)
   m_pressure = m_initialPressure;
 }
 
+void Tank::update(duration_t const &a_delta)
+{
+  m_deltaMs = static_cast<float>(a_delta.count());
+}
+
 void Tank::calculate()
 {
-  float deltaP{};
-  for (auto const &input : m_inputs) deltaP += std::get<float>(input.value);
-  m_pressure += deltaP;
+  // Inflow is per millisecond and scaled by the time that passed, a decimated package fills its tanks just as fast
+  // and passes settling the same instant only report the pressure. A tank with nonzero inflow keeps the package
+  // stepping, it'd skip straight to the next event otherwise.
+  m_deltaP = 0.f;
+  for (auto const &input : m_inputs) m_deltaP += std::get<float>(input.value);
+  m_pressure += m_deltaP * m_deltaMs;
   m_outputs[0].value = m_pressure;
   m_outputs[1].value = m_volume;
 }
@@ -77,11 +85,23 @@ void Tank::setInitialPressure(float const a_pressure)
 {
   m_initialPressure = a_pressure;
   m_pressure = a_pressure;
+  wakeUp();
 }
 
 void Tank::setVolume(float const a_volume)
 {
   m_volume = a_volume;
+  wakeUp();
+}
+
+void Tank::saveState(StateWriter &a_state) const
+{
+  a_state.write(m_pressure);
+}
+
+void Tank::loadState(StateReader &a_state)
+{
+  a_state.read(m_pressure);
 }
 
 } // namespace spaghetti::elements::pneumatic
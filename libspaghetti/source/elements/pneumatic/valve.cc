@@ -55,6 +55,9 @@ void Valve::update(duration_t const &a_delta)
 
 void Valve::calculate()
 {
+  // No time passes while settling after an event, the flow of the last step stays on the outputs.
+  if (m_deltaS <= 0.f) return;
+
   float const VALVE{ std::get<float>(m_inputs[0].value) };
   float const P1{ std::get<float>(m_inputs[1].value) };
   float const V1{ std::clamp(std::get<float>(m_inputs[2].value), MIN_V, MAX_V) };
@@ -73,7 +76,18 @@ void Valve::calculate()
     m_outputs[1].value = -(m_deltaP / V2);
   }
 
-  m_deltaP = VALVE * (RO * m_deltaV * m_deltaV) / 2.f * m_deltaS;
+  // Flow per millisecond, the tanks scale it by the time that passed.
+  m_deltaP = VALVE * (RO * m_deltaV * m_deltaV) / 2.f / 1000.f;
+}
+
+void Valve::saveState(StateWriter &a_state) const
+{
+  a_state.write(m_deltaS, m_deltaV, m_deltaP);
+}
+
+void Valve::loadState(StateReader &a_state)
+{
+  a_state.read(m_deltaS, m_deltaV, m_deltaP);
 }
 
 } // namespace spaghetti::elements::pneumatic
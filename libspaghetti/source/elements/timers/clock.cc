@@ -21,6 +21,7 @@
 // SOFTWARE.
 
 #include <spaghetti/elements/timers/clock.h>
+#include <spaghetti/package.h>
 
 namespace spaghetti::elements::timers {
 
@@ -49,16 +50,40 @@ void Clock::deserialize(Json const &a_json)
 
   auto const &PROPERTIES = a_json["properties"];
   m_duration = duration_t{ PROPERTIES["duration"].get<double>() };
+  m_restart = true;
 }
 
-void Clock::update(duration_t const &a_delta)
+void Clock::calculate()
 {
-  m_time += a_delta;
-  if (m_time >= m_duration) {
+  if (!m_restart) return;
+
+  m_restart = false;
+  schedule(m_duration);
+}
+
+void Clock::saveState(StateWriter &a_state) const
+{
+  a_state.write(m_restart, m_timer.timeLeft());
+}
+
+void Clock::loadState(StateReader &a_state)
+{
+  duration_t timeLeft{ duration_t::max() };
+  a_state.read(m_restart, timeLeft);
+
+  if (timeLeft != duration_t::max())
+    schedule(timeLeft);
+  else
+    m_timer.cancel();
+}
+
+void Clock::schedule(duration_t const &a_timeout)
+{
+  m_package->timerWheel().schedule(m_timer, a_timeout, [this] {
     bool const VALUE = !std::get<bool>(m_outputs[0].value);
     m_outputs[0].value = VALUE;
-    reset();
-  }
+    schedule(m_duration);
+  });
 }
 
 } // namespace spaghetti::elements::timers
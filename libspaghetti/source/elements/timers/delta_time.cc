@@ -38,6 +38,9 @@ DeltaTime::DeltaTime()
 
 void DeltaTime::update(duration_t const &a_delta)
 {
+  // Passes settling the same instant keep showing the last step.
+  if (a_delta == duration_t::zero()) return;
+
   m_delta = a_delta;
   m_outputs[0].value = static_cast<int32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(m_delta).count());
   m_outputs[1].value = static_cast<float>(m_delta.count()) / 1000.f;
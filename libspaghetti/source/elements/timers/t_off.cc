@@ -22,6 +22,7 @@
 
 #include <spaghetti/elements/timers/t_off.h>
 #include <spaghetti/logger.h>
+#include <spaghetti/package.h>
 
 namespace spaghetti::elements::timers {
 
@@ -40,30 +41,35 @@ TimerOff::TimerOff()
   addOutput(ValueType::eInt, "Elapsed [ms]", IOSocket::eCanHoldInt);
 }
 
-void TimerOff::update(duration_t const &a_delta)
-{
-  if (m_state == State::eRun) {
-    m_elapsedTime += a_delta;
-    if (m_elapsedTime >= m_presetTime) m_state = State::eDone;
-  }
-}
-
 void TimerOff::calculate()
 {
   bool const INPUT = std::get<bool>(m_inputs[0].value);
   int32_t const PRESET_MS = std::get<int32_t>(m_inputs[1].value);
   duration_t const PRESET = duration_t{ PRESET_MS };
 
-  if (PRESET != m_presetTime) m_presetTime = PRESET;
+  auto const NOW = m_package->timerWheel().now();
+
+  if (PRESET != m_presetTime) {
+    m_presetTime = PRESET;
+    if (m_state == State::eRun) schedule();
+  }
 
   if (INPUT != m_lastInput) {
     m_state = !INPUT ? State::eRun : State::eReset;
     m_lastInput = INPUT;
+
+    if (m_state == State::eRun) {
+      m_startTime = NOW;
+      schedule();
+    } else {
+      m_timer.cancel();
+    }
   }
 
   switch (m_state) {
     case State::eWaitForTrigger: break;
     case State::eRun:
+      m_elapsedTime = NOW - m_startTime;
       m_outputs[0].value = true;
       m_outputs[1].value =
           static_cast<int32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(m_elapsedTime).count());
@@ -82,4 +88,30 @@ void TimerOff::calculate()
   }
 }
 
+void TimerOff::saveState(StateWriter &a_state) const
+{
+  a_state.write(m_presetTime, m_startTime, m_elapsedTime, m_state, m_lastInput, m_timer.isActive());
+}
+
+void TimerOff::loadState(StateReader &a_state)
+{
+  bool running{};
+  a_state.read(m_presetTime, m_startTime, m_elapsedTime, m_state, m_lastInput, running);
+
+  // The start time is on the restored timer wheel clock, so the remaining time comes out right.
+  if (running)
+    schedule();
+  else
+    m_timer.cancel();
+}
+
+void TimerOff::schedule()
+{
+  auto &timers = m_package->timerWheel();
+  timers.schedule(m_timer, m_presetTime - (timers.now() - m_startTime), [this] {
+    m_elapsedTime = m_presetTime;
+    m_state = State::eDone;
+  });
+}
+
 } // namespace spaghetti::elements::timers
@@ -38,12 +38,24 @@ void PushButton::toggle()
 {
   m_currentValue = !m_currentValue;
   m_outputs[0].value = m_currentValue;
+  wakeUp();
 }
 
 void PushButton::set(bool a_state)
 {
   m_currentValue = a_state;
   m_outputs[0].value = m_currentValue;
+  wakeUp();
+}
+
+void PushButton::saveState(StateWriter &a_state) const
+{
+  a_state.write(m_currentValue);
+}
+
+void PushButton::loadState(StateReader &a_state)
+{
+  a_state.read(m_currentValue);
 }
 
 } // namespace spaghetti::elements::ui
@@ -38,12 +38,24 @@ void ToggleButton::toggle()
 {
   m_currentValue = !m_currentValue;
   m_outputs[0].value = m_currentValue;
+  wakeUp();
 }
 
 void ToggleButton::set(bool a_state)
 {
   m_currentValue = a_state;
   m_outputs[0].value = m_currentValue;
+  wakeUp();
+}
+
+void ToggleButton::saveState(StateWriter &a_state) const
+{
+  a_state.write(m_currentValue);
+}
+
+void ToggleButton::loadState(StateReader &a_state)
+{
+  a_state.read(m_currentValue);
 }
 
 } // namespace spaghetti::elements::ui
@@ -120,6 +120,7 @@ void CharacteristicCurve::setSeriesCount(size_t const a_seriesCount)
 {
   if (a_seriesCount < 2) return;
   m_series.resize(a_seriesCount);
+  wakeUp();
 }
 
 void CharacteristicCurve::clearSeries()
@@ -127,6 +128,7 @@ void CharacteristicCurve::clearSeries()
   m_series.clear();
   m_series.push_back({ m_xRange.x, m_yRange.x });
   m_series.push_back({ m_xRange.y, m_yRange.y });
+  wakeUp();
 }
 
 } // namespace spaghetti::elements::values
@@ -56,12 +56,14 @@ void ConstBool::toggle()
 {
   m_currentValue = !m_currentValue;
   m_outputs[0].value = m_currentValue;
+  wakeUp();
 }
 
 void ConstBool::set(bool a_state)
 {
   m_currentValue = a_state;
   m_outputs[0].value = m_currentValue;
+  wakeUp();
 }
 
 } // namespace spaghetti::elements::values
@@ -56,6 +56,7 @@ void ConstFloat::set(float a_value)
 {
   m_currentValue = a_value;
   m_outputs[0].value = m_currentValue;
+  wakeUp();
 }
 
 } // namespace spaghetti::elements::values
@@ -56,4 +56,14 @@ void RandomBool::calculate()
   }
 }
 
+void RandomBool::saveState(StateWriter &a_state) const
+{
+  a_state.write(m_state);
+}
+
+void RandomBool::loadState(StateReader &a_state)
+{
+  a_state.read(m_state);
+}
+
 } // namespace spaghetti::elements::values
@@ -73,4 +73,14 @@ void RandomFloat::calculate()
   m_state = STATE;
 }
 
+void RandomFloat::saveState(StateWriter &a_state) const
+{
+  a_state.write(m_state);
+}
+
+void RandomFloat::loadState(StateReader &a_state)
+{
+  a_state.read(m_state);
+}
+
 } // namespace spaghetti::elements::values
@@ -73,4 +73,14 @@ void RandomInt::calculate()
   m_state = STATE;
 }
 
+void RandomInt::saveState(StateWriter &a_state) const
+{
+  a_state.write(m_state);
+}
+
+void RandomInt::loadState(StateReader &a_state)
+{
+  a_state.read(m_state);
+}
+
 } // namespace spaghetti::elements::values
@@ -94,4 +94,14 @@ void RandomIntIf::calculate()
   m_outputs[0].value = m_value;
 }
 
+void RandomIntIf::saveState(StateWriter &a_state) const
+{
+  a_state.write(m_elapsed, m_enabledInterval, m_disabledInterval, m_value, m_enabled);
+}
+
+void RandomIntIf::loadState(StateReader &a_state)
+{
+  a_state.read(m_elapsed, m_enabledInterval, m_disabledInterval, m_value, m_enabled);
+}
+
 } // namespace spaghetti::elements::values
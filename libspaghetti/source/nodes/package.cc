@@ -22,6 +22,7 @@
 
 #include <QDebug>
 #include <QLineEdit>
+#include <QSpinBox>
 #include <QTableWidget>
 
 #include "nodes/package.h"
@@ -72,6 +73,22 @@ void Package::showProperties()
     /* TODO */
   });
 
+  if (package->package() != nullptr) {
+    row = m_properties->rowCount();
+    m_properties->insertRow(row);
+    item = new QTableWidgetItem{ "Rate divisor" };
+    item->setFlags(item->flags() & ~Qt::ItemIsEditable);
+    m_properties->setItem(row, 0, item);
+
+    QSpinBox *rateDivisor = new QSpinBox;
+    rateDivisor->setRange(1, 10000);
+    rateDivisor->setValue(static_cast<int>(package->rateDivisor()));
+    rateDivisor->setPrefix("1/");
+    m_properties->setCellWidget(row, 1, rateDivisor);
+    QObject::connect(rateDivisor, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged),
+                     [package](int a_value) { package->setRateDivisor(static_cast<uint32_t>(a_value)); });
+  }
+
   showIOProperties(IOSocketsType::eInputs);
   showIOProperties(IOSocketsType::eOutputs);
 }
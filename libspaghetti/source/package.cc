@@ -20,17 +20,206 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+#include <algorithm>
+#include <cstdio>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <numeric>
+#include <random>
 #include <string_view>
+#include <tuple>
 
 #include "spaghetti/package.h"
 
 #include "spaghetti/logger.h"
+#include "spaghetti/package_bundle.h"
+#include "spaghetti/package_file.h"
+#include "spaghetti/package_journal.h"
 #include "spaghetti/registry.h"
 
+#include "filesystem.h"
+
 namespace spaghetti {
 
+namespace {
+
+std::vector<size_t> dense_ids(Package::Elements const &a_elements)
+{
+  // Saved ids are dense regardless of holes left by removed elements.
+  size_t const DATA_SIZE{ a_elements.size() };
+  std::vector<size_t> denseIds(DATA_SIZE);
+  size_t nextId{ 1 };
+  for (size_t i = 1; i < DATA_SIZE; ++i)
+    if (a_elements[i]) denseIds[i] = nextId++;
+  return denseIds;
+}
+
+Element::Json serialize_element(Element &a_element, size_t const a_denseId)
+{
+  Element::Json jsonElement{};
+  a_element.serialize(jsonElement);
+  jsonElement["element"]["id"] = a_denseId;
+  return jsonElement;
+}
+
+Element::Json serialize_connection(Package::Connection const &a_connection, std::vector<size_t> const &a_denseIds)
+{
+  Element::Json jsonConnection{}, jsonConnect{}, jsonTo{};
+
+  jsonConnect["id"] = a_denseIds[a_connection.from_id];
+  jsonConnect["socket"] = a_connection.from_socket;
+  jsonTo["id"] = a_denseIds[a_connection.to_id];
+  jsonTo["socket"] = a_connection.to_socket;
+
+  jsonConnection["connect"] = jsonConnect;
+  jsonConnection["to"] = jsonTo;
+  return jsonConnection;
+}
+
+void serialize_contents(Element::Json &a_json, Package::Elements const &a_elements,
+                        Package::Connections const &a_connections)
+{
+  auto const DENSE_IDS = dense_ids(a_elements);
+
+  auto jsonElements = Element::Json::array();
+  size_t const DATA_SIZE{ a_elements.size() };
+  for (size_t i = 1; i < DATA_SIZE; ++i)
+    if (a_elements[i]) jsonElements.push_back(serialize_element(*a_elements[i], DENSE_IDS[i]));
+  a_json["package"]["elements"] = jsonElements;
+
+  auto jsonConnections = Element::Json::array();
+  for (auto const &CONNECTION : a_connections) jsonConnections.push_back(serialize_connection(CONNECTION, DENSE_IDS));
+  a_json["package"]["connections"] = jsonConnections;
+}
+
+// Checkpoints start with a header followed by the root package written as an element record: its type hash,
+// socket values and a block with whatever Element::saveState() added. Packages put their children there.
+constexpr uint32_t const CHECKPOINT_MAGIC{ 0x4B435053 }; // "SPCK"
+constexpr uint32_t const CHECKPOINT_VERSION{ 1 };
+
+void mix(uint64_t &a_signature, uint64_t const a_value)
+{
+  a_signature = (a_signature ^ a_value) * 0x100000001b3;
+}
+
+void mix_layout(uint64_t &a_signature, Package const &a_package)
+{
+  auto const &ELEMENTS = a_package.elements();
+  size_t const SIZE{ ELEMENTS.size() };
+  for (size_t i = 0; i < SIZE; ++i) {
+    auto const element = ELEMENTS[i];
+    if (element == nullptr) continue;
+
+    mix(a_signature, i);
+    mix(a_signature, element->hash());
+    mix(a_signature, element->inputs().size());
+    mix(a_signature, element->outputs().size());
+    if (i > 0 && element->hash() == Package::HASH) mix_layout(a_signature, *static_cast<Package const *>(element));
+  }
+}
+
+uint64_t layout_signature(Package const &a_package)
+{
+  uint64_t signature{ 0xcbf29ce484222325 };
+  mix_layout(signature, a_package);
+  return signature;
+}
+
+// Cached plans hold everything buildPlan() fills in, see Package::writePlan().
+constexpr uint32_t const PLAN_MAGIC{ 0x4C505053 }; // "SPPL"
+constexpr uint32_t const PLAN_VERSION{ 2 };
+
+uint64_t hash_text(std::string const &a_text)
+{
+  uint64_t hash{ 0xcbf29ce484222325 };
+  for (auto const CHARACTER : a_text) mix(hash, static_cast<uint8_t>(CHARACTER));
+  return hash;
+}
+
+// Journals start over once they are half the size of the file, but not before there's enough to bother.
+constexpr size_t const JOURNAL_MIN_REWRITE_SIZE{ 64 * 1024 };
+
+bool connection_less(Package::Connection const &a_lhs, Package::Connection const &a_rhs)
+{
+  return std::tie(a_lhs.from_id, a_lhs.from_socket, a_lhs.to_id, a_lhs.to_socket) <
+         std::tie(a_rhs.from_id, a_rhs.from_socket, a_rhs.to_id, a_rhs.to_socket);
+}
+
+Element::Json connection_entry(char const *const a_operation, Package::Connection const &a_connection)
+{
+  Element::Json entry{};
+  entry[a_operation] = { a_connection.from_id, a_connection.from_socket, a_connection.to_id, a_connection.to_socket };
+  return entry;
+}
+
+void save_value(StateWriter &a_state, Element::Value const &a_value)
+{
+  a_state.write(static_cast<uint8_t>(a_value.index()));
+  std::visit([&a_state](auto const a_data) { a_state.write(a_data); }, a_value);
+}
+
+template<typename T>
+void load_value_as(StateReader &a_state, Element::Value &a_value)
+{
+  T data{};
+  a_state.read(data);
+  a_value = data;
+}
+
+void load_value(StateReader &a_state, Element::Value &a_value)
+{
+  uint8_t index{};
+  a_state.read(index);
+  switch (index) {
+    case 0: load_value_as<bool>(a_state, a_value); break;
+    case 1: load_value_as<int32_t>(a_state, a_value); break;
+    case 2: load_value_as<float>(a_state, a_value); break;
+    default: a_state.fail(); break;
+  }
+}
+
+void save_element(StateWriter &a_state, Element const &a_element)
+{
+  a_state.write(a_element.hash(), static_cast<uint8_t>(a_element.inputs().size()));
+  for (auto const &INPUT : a_element.inputs()) save_value(a_state, INPUT.value);
+  a_state.write(static_cast<uint8_t>(a_element.outputs().size()));
+  for (auto const &OUTPUT : a_element.outputs()) save_value(a_state, OUTPUT.value);
+
+  auto const BLOCK = a_state.beginBlock();
+  a_element.saveState(a_state);
+  a_state.endBlock(BLOCK);
+}
+
+void load_element(StateReader &a_state, Element &a_element)
+{
+  string::hash_t hash{};
+  uint8_t inputsCount{};
+  a_state.read(hash, inputsCount);
+  if (hash != a_element.hash() || inputsCount != a_element.inputs().size()) {
+    a_state.fail();
+    return;
+  }
+  for (auto &input : a_element.inputs()) load_value(a_state, input.value);
+
+  uint8_t outputsCount{};
+  a_state.read(outputsCount);
+  if (outputsCount != a_element.outputs().size()) {
+    a_state.fail();
+    return;
+  }
+  for (auto &output : a_element.outputs()) load_value(a_state, output.value);
+
+  auto state = a_state.block();
+  if (a_state.failed()) return;
+
+  a_element.loadState(state);
+  if (state.failed()) a_state.fail();
+  a_element.touch();
+}
+
+} // namespace
+
 Package::Package()
   : Element{}
 {
@@ -40,13 +229,40 @@ Package::Package()
   setDefaultNewOutputFlags(IOSocket::eDefaultFlags);
 }
 
+Package::Package(Package const &a_other)
+  : Element{ a_other }
+  , m_packageDescription{ a_other.m_packageDescription }
+  , m_packagePath{ a_other.m_packagePath }
+  , m_packageIcon{ a_other.m_packageIcon }
+  , m_rateDivisor{ a_other.m_rateDivisor }
+  , m_inputsPosition{ a_other.m_inputsPosition }
+  , m_outputsPosition{ a_other.m_outputsPosition }
+  , m_simulationStep{ a_other.m_simulationStep }
+  , m_isExternal{ a_other.m_isExternal }
+  , m_isHeadless{ a_other.m_isHeadless }
+{
+  m_elements.push_back(this);
+
+  copyContents(a_other);
+  m_workerCount = a_other.m_workerCount;
+  m_partitionsDirty = true;
+}
+
 Package::~Package()
 {
+  stopWorkers();
+
   size_t const SIZE{ m_elements.size() };
   for (size_t i = 1; i < SIZE; ++i) delete m_elements[i];
 }
 
 void Package::serialize(Element::Json &a_json)
+{
+  serializeHeader(a_json);
+  if (!m_isExternal) serialize_contents(a_json, m_elements, m_wiring->connections);
+}
+
+void Package::serializeHeader(Json &a_json)
 {
   Element::serialize(a_json);
 
@@ -60,36 +276,7 @@ void Package::serialize(Element::Json &a_json)
   jsonPackage["description"] = m_packageDescription;
   jsonPackage["path"] = m_packagePath;
   jsonPackage["icon"] = m_packageIcon;
-
-  if (!m_isExternal) {
-    auto jsonElements = Json::array();
-    // TODO(aljen): fix holes
-    size_t const DATA_SIZE{ m_elements.size() };
-    for (size_t i = 1; i < DATA_SIZE; ++i) {
-      auto const element = m_elements[i];
-      if (element == nullptr) continue;
-
-      Json jsonElement{};
-      element->serialize(jsonElement);
-      jsonElements.push_back(jsonElement);
-    }
-    jsonPackage["elements"] = jsonElements;
-
-    auto jsonConnections = Json::array();
-    for (auto const &CONNECTION : m_connections) {
-      Json jsonConnection{}, jsonConnect{}, jsonTo{};
-
-      jsonConnect["id"] = CONNECTION.from_id;
-      jsonConnect["socket"] = CONNECTION.from_socket;
-      jsonTo["id"] = CONNECTION.to_id;
-      jsonTo["socket"] = CONNECTION.to_socket;
-
-      jsonConnection["connect"] = jsonConnect;
-      jsonConnection["to"] = jsonTo;
-      jsonConnections.push_back(jsonConnection);
-    }
-    jsonPackage["connections"] = jsonConnections;
-  }
+  jsonPackage["rate_divisor"] = m_rateDivisor;
 }
 
 void Package::deserialize(Json const &a_json)
@@ -110,46 +297,32 @@ void Package::deserialize(Json const &a_json)
   auto const &DESCRIPTION = PACKAGE["description"].get<std::string>();
   auto const &ICON = PACKAGE["icon"].get<std::string>();
   auto const &PATH = PACKAGE["path"].get<std::string>();
+  auto const RATE_DIVISOR = PACKAGE.value("rate_divisor", uint32_t{ 1 });
 
   m_isExternal = !IS_ROOT && !PATH.empty();
 
   spaghetti::log::debug("deserialize root? {} isExternal? {}", IS_ROOT, m_isExternal);
 
-  Json json{};
+  setPackageDescription(DESCRIPTION);
+  setPackageIcon(ICON);
+  setPackagePath(PATH);
+  setRateDivisor(RATE_DIVISOR);
+  setInputsPosition(INPUTS_POSITION_X, INPUTS_POSITION_Y);
+  setOutputsPosition(OUTPUTS_POSITION_X, OUTPUTS_POSITION_Y);
 
   if (m_isExternal) {
-    log::debug("Package is external one, looking for real one registered as '{}'", PATH);
-
-    auto const &REGISTRY = Registry::get();
-    auto const &PACKAGES = REGISTRY.packages();
-
-    std::string filename{};
+    log::debug("Package is external one, cloning prototype registered as '{}'", PATH);
 
-    for (auto const &PACKAGE_INFO : PACKAGES) {
-      if (PACKAGE_INFO.second.path == PATH) {
-        filename = PACKAGE_INFO.second.filename;
-        log::debug("Found one, '{}' is at '{}'", PATH, filename);
-        break;
-      }
-    }
-
-    assert(!filename.empty() && "Can't find external package");
-
-    std::ifstream file{ filename };
-    if (!file.is_open()) return;
+    auto const prototype = Registry::get().packagePrototype(PATH);
+    assert(prototype && "Can't find external package");
+    if (prototype == nullptr) return;
 
-    file >> json;
+    copyContents(*prototype);
+    return;
   }
 
-  auto const &REAL_PACKAGE = m_isExternal ? json["package"] : PACKAGE;
-  auto const &ELEMENTS = REAL_PACKAGE["elements"];
-  auto const &CONNECTIONS = REAL_PACKAGE["connections"];
-
-  setPackageDescription(DESCRIPTION);
-  setPackageIcon(ICON);
-  setPackagePath(PATH);
-  setInputsPosition(INPUTS_POSITION_X, INPUTS_POSITION_Y);
-  setOutputsPosition(OUTPUTS_POSITION_X, OUTPUTS_POSITION_Y);
+  auto const &ELEMENTS = PACKAGE["elements"];
+  auto const &CONNECTIONS = PACKAGE["connections"];
 
   std::map<size_t, size_t> remappedIds{};
 
@@ -177,211 +350,1144 @@ void Package::deserialize(Json const &a_json)
 
 void Package::calculate()
 {
-  for (auto &&connection : m_connections) {
-    Element *const source{ get(connection.from_id) };
-    Element *const target{ get(connection.to_id) };
-
-    auto const IS_SOURCE_SELF = connection.from_id == 0;
-    auto const IS_TARGET_SELF = connection.to_id == 0;
-
-    auto const &SOURCE_IO = IS_SOURCE_SELF ? source->inputs() : source->outputs();
-    auto &targetIO = IS_TARGET_SELF ? target->outputs() : target->inputs();
-    targetIO[connection.to_socket].value = SOURCE_IO[connection.from_socket].value;
+  // Ticks are counted by update(), passes without time passing don't bring the next run closer. Right after a run
+  // such passes run the package again, its inputs may have changed since.
+  if (m_skippedTicks != 0 && m_skippedTicks < m_rateDivisor) {
+    size_t const INPUTS_COUNT{ m_inputs.size() };
+    for (size_t socket = 0; socket < INPUTS_COUNT && !m_changed; ++socket) {
+      for (auto const INDEX : fanOutOf(0, static_cast<uint8_t>(socket))) {
+        auto const &CONNECTION = m_wiring->connections[INDEX];
+        Element *const target{ get(CONNECTION.to_id) };
+        auto const &TARGET_IO = CONNECTION.to_id == 0 ? target->outputs() : target->inputs();
+        m_changed = TARGET_IO[CONNECTION.to_socket].value != m_inputs[socket].value;
+        if (m_changed) break;
+      }
+    }
+    return;
   }
+  m_skippedTicks = 0;
 
-  for (auto &&element : m_elements) {
-    if (!element || element == this) continue;
+  if (m_wiring->planDirty) buildPlan();
+  if (m_partitionsDirty) partitionPlan();
+  if (m_workers.size() + 1 < m_partitions.size()) startWorkers();
 
-    element->update(m_delta);
-    element->calculate();
-  }
-}
+  bool changed{};
 
-Element *Package::add(string::hash_t const a_hash)
-{
-  pauseDispatchThread();
+  if (m_workers.empty()) {
+    changed = runPartition(0);
+  } else {
+    {
+      std::lock_guard<std::mutex> lock{ m_workMutex };
+      m_pendingWorkers = m_workers.size();
+      ++m_workGeneration;
+    }
+    m_workCondition.notify_all();
 
-  spaghetti::log::debug("Adding element..");
+    changed = runPartition(0);
 
-  spaghetti::Registry &registry{ spaghetti::Registry::get() };
+    std::unique_lock<std::mutex> lock{ m_workMutex };
+    m_workDoneCondition.wait(lock, [this] { return m_pendingWorkers == 0; });
+    for (size_t i = 1; i < m_partitionChanged.size(); ++i) changed = changed || m_partitionChanged[i];
+  }
 
-  Element *const element{ registry.createElement(a_hash) };
-  assert(element);
+  size_t const CUTS_COUNT{ m_cutConnections.size() };
+  for (size_t i = 0; i < CUTS_COUNT; ++i) {
+    auto const &CONNECTION = m_wiring->connections[m_cutConnections[i]];
+    auto const &SOURCE_VALUE = m_elements[CONNECTION.from_id]->m_outputs[CONNECTION.from_socket].value;
+    if (m_cutValues[i] == SOURCE_VALUE) continue;
 
-  size_t index{};
-  if (m_free.empty()) {
-    index = m_elements.size();
-    m_elements.emplace_back(element);
-  } else {
-    index = m_free.back();
-    assert(m_elements[index] == nullptr);
-    m_elements[index] = element;
-    m_free.pop_back();
+    m_cutValues[i] = SOURCE_VALUE;
+    changed = true;
   }
 
-  element->m_package = this;
-  element->m_id = index;
-  element->reset();
+  for (auto const INDEX : m_wiring->outgoing) {
+    auto const &CONNECTION = m_wiring->connections[INDEX];
+    Element *const source{ get(CONNECTION.from_id) };
+    auto const &SOURCE_IO = CONNECTION.from_id == 0 ? source->inputs() : source->outputs();
+    auto const &SOURCE_VALUE = SOURCE_IO[CONNECTION.from_socket].value;
+    auto &targetValue = m_outputs[CONNECTION.to_socket].value;
+    if (targetValue == SOURCE_VALUE) continue;
 
-  resumeDispatchThread();
+    targetValue = SOURCE_VALUE;
+    changed = true;
+  }
 
-  return element;
+  m_changed = changed;
+  m_delta = duration_t::zero();
 }
 
-void Package::remove(size_t const a_id)
+void Package::update(duration_t const &a_delta)
 {
-  pauseDispatchThread();
-
-  spaghetti::log::debug("Removing element {}..", a_id);
-
-  assert(a_id > 0);
-  assert(a_id < m_elements.size());
-  assert(std::find(std::begin(m_free), std::end(m_free), a_id) == std::end(m_free));
-
-  delete m_elements[a_id];
-  m_elements[a_id] = nullptr;
-  m_free.emplace_back(a_id);
-
-  resumeDispatchThread();
+  m_delta += a_delta;
+  if (a_delta > duration_t::zero()) ++m_skippedTicks;
+  if (m_package == nullptr) m_timerWheel.advance(a_delta);
 }
 
-Element *Package::get(size_t const a_id) const
+bool Package::runPartition(size_t const a_partition)
 {
-  assert(a_id < m_elements.size());
-  assert(std::find(std::begin(m_free), std::end(m_free), a_id) == std::end(m_free));
-  return m_elements[a_id];
-}
+  size_t const MAX_ITERATIONS{ 64 };
+
+  auto &lastOutputs = m_lastOutputs[a_partition];
+  bool changed{};
+
+  for (auto const STEP_INDEX : m_partitions[a_partition]) {
+    auto const &STEP = m_wiring->plan[STEP_INDEX];
+
+    if (!STEP.cyclic) {
+      for (size_t i = STEP.first; i < STEP.first + STEP.count; ++i) {
+        auto const ID = m_wiring->planOrder[i];
+        bool const INPUTS_CHANGED{ pullInputs(ID) };
+        bool const OUTPUTS_CHANGED{ evaluate(m_elements[ID], m_delta, lastOutputs) };
+        if (INPUTS_CHANGED || OUTPUTS_CHANGED) {
+          m_elements[ID]->touch();
+          changed = true;
+        }
+      }
+      continue;
+    }
 
-bool Package::connect(size_t const a_sourceId, uint8_t const a_sourceSocket, size_t const a_targetId,
-                      uint8_t const a_targetSocket)
-{
-  pauseDispatchThread();
+    auto delta = m_delta;
+    bool loopChanged{ true };
+    size_t iterations{};
+    for (; loopChanged && iterations < MAX_ITERATIONS; ++iterations) {
+      loopChanged = false;
+      for (size_t i = STEP.first; i < STEP.first + STEP.count; ++i) {
+        auto const ID = m_wiring->planOrder[i];
+        bool const INPUTS_CHANGED{ pullInputs(ID) };
+        bool const OUTPUTS_CHANGED{ evaluate(m_elements[ID], delta, lastOutputs) };
+        if (INPUTS_CHANGED || OUTPUTS_CHANGED) {
+          m_elements[ID]->touch();
+          loopChanged = true;
+        }
+      }
+      if (loopChanged) changed = true;
+      delta = duration_t::zero();
+    }
 
-  auto const source = get(a_sourceId);
-  auto const target = get(a_targetId);
+    if (loopChanged && !m_warnedSteps[STEP_INDEX]) {
+      log::warn("Feedback loop starting at element {} didn't settle after {} iterations",
+                m_wiring->planOrder[STEP.first], iterations);
+      m_warnedSteps[STEP_INDEX] = true;
+    }
+  }
 
-  spaghetti::log::debug("Connecting source: {}@{} to target: {}@{}", a_sourceId, static_cast<int>(a_sourceSocket),
-                        a_targetId, static_cast<int>(a_targetSocket));
+  m_partitionChanged[a_partition] = changed;
 
-  auto const &SOURCE = a_sourceId != 0 ? source->m_outputs : source->m_inputs;
-  auto &TARGET = a_targetId != 0 ? target->m_inputs : target->m_outputs;
-  auto const SOURCE_SIZE = SOURCE.size();
-  auto const TARGET_SIZE = TARGET.size();
-  assert(a_sourceSocket < SOURCE_SIZE && "Socket ID don't exist");
-  assert(a_targetSocket < TARGET_SIZE && "Socket ID don't exist");
+  return changed;
+}
 
-  TARGET[a_targetSocket].id = a_sourceId;
-  TARGET[a_targetSocket].slot = a_sourceSocket;
+bool Package::pullInputs(size_t const a_id)
+{
+  bool changed{};
+
+  auto &inputs = m_elements[a_id]->m_inputs;
+  for (auto const INDEX : m_wiring->incoming[a_id]) {
+    auto const &CONNECTION = m_wiring->connections[INDEX];
+    auto const CUT_SLOT = m_cutSlots[INDEX];
+    Element *const source{ m_elements[CONNECTION.from_id] };
+    auto const &SOURCE_IO = CONNECTION.from_id == 0 ? source->m_inputs : source->m_outputs;
+    auto const &SOURCE_VALUE =
+        CUT_SLOT < 0 ? SOURCE_IO[CONNECTION.from_socket].value : m_cutValues[static_cast<size_t>(CUT_SLOT)];
+    auto &targetValue = inputs[CONNECTION.to_socket].value;
+    if (targetValue == SOURCE_VALUE) continue;
+
+    targetValue = SOURCE_VALUE;
+    changed = true;
+  }
 
-  spaghetti::log::debug("Notifying {}({})@{} when {}({})@{} changes..", a_targetId, target->name(),
-                        static_cast<int32_t>(a_targetSocket), a_sourceId, source->name(),
-                        static_cast<int32_t>(a_sourceSocket));
+  return changed;
+}
 
-  m_connections.emplace_back(Connection{ a_sourceId, a_sourceSocket, a_targetId, a_targetSocket });
+bool Package::evaluate(Element *const a_element, duration_t const &a_delta, std::vector<Value> &a_lastOutputs)
+{
+  // Outputs are always compared, a changed element is marked for the next snapshot.
+  a_lastOutputs.clear();
+  for (auto const &OUTPUT : a_element->outputs()) a_lastOutputs.push_back(OUTPUT.value);
 
-  auto &dependencies = m_dependencies[a_sourceId];
-  auto const IT = std::find(std::begin(dependencies), std::end(dependencies), a_targetId);
-  if (IT == std::end(dependencies)) dependencies.push_back(a_targetId);
+  a_element->update(a_delta);
+  a_element->calculate();
 
-  resumeDispatchThread();
+  auto const &OUTPUTS = a_element->outputs();
+  size_t const OUTPUTS_COUNT{ OUTPUTS.size() };
+  if (OUTPUTS_COUNT != a_lastOutputs.size()) return true;
+  for (size_t i = 0; i < OUTPUTS_COUNT; ++i)
+    if (OUTPUTS[i].value != a_lastOutputs[i]) return true;
 
-  return true;
+  return false;
 }
 
-bool Package::disconnect(size_t const a_sourceId, uint8_t const a_outputId, size_t const a_targetId,
-                         uint8_t const a_inputId)
+void Package::buildPlan() const
 {
-  pauseDispatchThread();
+  // The plan only caches what the connections imply, so it's filled in place even while the wiring is shared.
+  auto &wiring = *m_wiring;
+  size_t const COUNT{ m_elements.size() };
+
+  auto const CACHE_PATH = Registry::get().planCachePath();
+  uint64_t const KEY{ CACHE_PATH.empty() ? 0 : planKey() };
+  std::string planFilename{};
+  if (!CACHE_PATH.empty()) {
+    char name[32]{};
+    std::snprintf(name, sizeof(name), "%016llx.plan", static_cast<unsigned long long>(KEY));
+    planFilename = (fs::path{ CACHE_PATH } / name).string();
+    if (readPlan(planFilename, KEY)) {
+      wiring.planDirty = false;
+      return;
+    }
+  }
 
-  Element *const target{ get(a_targetId) };
+  wiring.plan.clear();
+  wiring.planOrder.clear();
+  wiring.outgoing.clear();
+  wiring.delayed.clear();
+  wiring.incoming.assign(COUNT, {});
 
-  spaghetti::log::debug("Disconnecting source: {}@{} from target: {}@{}", a_sourceId, static_cast<int>(a_outputId),
-                        a_targetId, static_cast<int>(a_inputId));
+  std::vector<std::vector<size_t>> successors(COUNT);
+  std::vector<bool> selfLoop(COUNT);
 
-  auto &targetInput = target->m_inputs[a_inputId];
-  targetInput.id = 0;
-  targetInput.slot = 0;
-  resetIOSocketValue(targetInput);
+  size_t const CONNECTIONS_COUNT{ wiring.connections.size() };
+  for (size_t i = 0; i < CONNECTIONS_COUNT; ++i) {
+    auto const &CONNECTION = wiring.connections[i];
+    if (CONNECTION.from_id >= COUNT || !m_elements[CONNECTION.from_id]) continue;
+    if (CONNECTION.to_id >= COUNT || !m_elements[CONNECTION.to_id]) continue;
 
-  auto it = std::remove_if(std::begin(m_connections), std::end(m_connections), [=](Connection &a_connection) {
-    return a_connection.from_id == a_sourceId && a_connection.from_socket == a_outputId &&
-           a_connection.to_id == a_targetId && a_connection.to_socket == a_inputId;
-  });
-  m_connections.erase(it, std::end(m_connections));
+    if (CONNECTION.to_id == 0) {
+      wiring.outgoing.push_back(i);
+      continue;
+    }
 
-  auto &dependencies = m_dependencies[a_sourceId];
-  dependencies.erase(std::find(std::begin(dependencies), std::end(dependencies), a_targetId), std::end(dependencies));
+    wiring.incoming[CONNECTION.to_id].push_back(i);
+    if (CONNECTION.from_id == 0) continue;
+    if (CONNECTION.from_id == CONNECTION.to_id) selfLoop[CONNECTION.to_id] = true;
+    successors[CONNECTION.from_id].push_back(CONNECTION.to_id);
+  }
 
-  resumeDispatchThread();
+  // Iterative Tarjan; components come out sinks first, so they're reversed afterwards.
+  size_t const UNVISITED{ std::numeric_limits<size_t>::max() };
+  std::vector<size_t> index(COUNT, UNVISITED);
+  std::vector<size_t> lowLink(COUNT);
+  std::vector<bool> onStack(COUNT);
+  std::vector<size_t> stack{};
+  std::vector<std::pair<size_t, size_t>> callStack{};
+  std::vector<size_t> order{};
+  std::vector<size_t> componentOf(COUNT, UNVISITED);
+  std::vector<PlanStep> steps{};
+  size_t nextIndex{};
+
+  for (size_t root = 1; root < COUNT; ++root) {
+    if (!m_elements[root] || index[root] != UNVISITED) continue;
+
+    callStack.emplace_back(root, 0);
+    while (!callStack.empty()) {
+      auto &[id, edge] = callStack.back();
+
+      if (edge == 0 && index[id] == UNVISITED) {
+        index[id] = lowLink[id] = nextIndex++;
+        stack.push_back(id);
+        onStack[id] = true;
+      }
 
-  return true;
-}
+      if (edge < successors[id].size()) {
+        auto const NEXT = successors[id][edge++];
+        if (index[NEXT] == UNVISITED)
+          callStack.emplace_back(NEXT, 0);
+        else if (onStack[NEXT])
+          lowLink[id] = std::min(lowLink[id], index[NEXT]);
+        continue;
+      }
 
-void Package::dispatchThreadFunction()
-{
-  using clock_t = std::chrono::high_resolution_clock;
+      auto const ID = id;
+      callStack.pop_back();
+      if (!callStack.empty()) {
+        auto const PARENT = callStack.back().first;
+        lowLink[PARENT] = std::min(lowLink[PARENT], lowLink[ID]);
+      }
 
-  auto const ONE_MILLISECOND = std::chrono::milliseconds(1);
+      if (lowLink[ID] != index[ID]) continue;
+
+      PlanStep step{};
+      step.first = order.size();
+      size_t member{};
+      do {
+        member = stack.back();
+        stack.pop_back();
+        onStack[member] = false;
+        componentOf[member] = steps.size();
+        order.push_back(member);
+      } while (member != ID);
+      step.count = order.size() - step.first;
+      step.cyclic = step.count > 1 || selfLoop[ID];
+      steps.push_back(step);
+    }
+  }
 
-  auto last = clock_t::now() - ONE_MILLISECOND;
+  // Members of a cyclic component are ordered by a depth first walk from where the loop is entered: the input fed
+  // by the earliest element outside of it, or by the earliest connection inside if nothing feeds it. Edges against
+  // that order are the loop's back edges.
+  std::vector<size_t> position(COUNT, UNVISITED);
+  std::vector<bool> seen(COUNT);
+  std::vector<std::pair<size_t, size_t>> walk{};
+  std::vector<size_t> postOrder{};
+
+  for (auto it = std::rbegin(steps); it != std::rend(steps); ++it) {
+    PlanStep step{ wiring.planOrder.size(), it->count, it->cyclic };
+    auto const MEMBERS = std::begin(order) + static_cast<std::ptrdiff_t>(it->first);
+
+    if (!step.cyclic) {
+      position[*MEMBERS] = wiring.planOrder.size();
+      wiring.planOrder.push_back(*MEMBERS);
+      wiring.plan.push_back(step);
+      continue;
+    }
 
-  while (!m_quit) {
-    auto const NOW = clock_t::now();
-    auto const DELTA = NOW - last;
+    auto const COMPONENT = componentOf[*MEMBERS];
+    auto const is_member = [&](size_t const a_id) { return a_id != 0 && componentOf[a_id] == COMPONENT; };
+
+    std::tuple<size_t, size_t, size_t> entry{ UNVISITED, UNVISITED, UNVISITED };
+    bool combinational{ true };
+    for (auto member = MEMBERS; member != MEMBERS + static_cast<std::ptrdiff_t>(step.count); ++member) {
+      combinational = combinational && m_elements[*member]->isCombinational();
+      for (auto const INDEX : wiring.incoming[*member]) {
+        auto const FROM = wiring.connections[INDEX].from_id;
+        size_t const SOURCE{ is_member(FROM) ? UNVISITED : FROM == 0 ? 0 : position[FROM] + 1 };
+        entry = std::min(entry, std::make_tuple(SOURCE, INDEX, *member));
+      }
+    }
 
-    update(DELTA);
-    calculate();
+    postOrder.clear();
+    walk.emplace_back(std::get<2>(entry), 0);
+    seen[std::get<2>(entry)] = true;
+    while (!walk.empty()) {
+      auto &[id, edge] = walk.back();
+      if (edge < successors[id].size()) {
+        auto const NEXT = successors[id][edge++];
+        if (is_member(NEXT) && !seen[NEXT]) {
+          seen[NEXT] = true;
+          walk.emplace_back(NEXT, 0);
+        }
+        continue;
+      }
 
-    last = NOW;
+      postOrder.push_back(id);
+      walk.pop_back();
+    }
+    assert(postOrder.size() == step.count);
 
-    auto const WAIT_START = clock_t::now();
-    while ((clock_t::now() - WAIT_START) < ONE_MILLISECOND) std::this_thread::sleep_for(ONE_MILLISECOND);
+    for (auto member = std::rbegin(postOrder); member != std::rend(postOrder); ++member) {
+      position[*member] = wiring.planOrder.size();
+      wiring.planOrder.push_back(*member);
+    }
 
-    if (m_pause) {
-      spaghetti::log::trace("Pause requested..");
-      m_paused = true;
-      spaghetti::log::trace("Pausing..");
-      while (m_pause) std::this_thread::yield();
-      m_paused = false;
-      spaghetti::log::trace("Pause stopped..");
+    // Iterating a loop through stateful elements would advance them more than once a tick, it's cut instead.
+    if (!combinational) {
+      step.cyclic = false;
+      for (auto const MEMBER : postOrder)
+        for (auto const INDEX : wiring.incoming[MEMBER]) {
+          auto const FROM = wiring.connections[INDEX].from_id;
+          if (is_member(FROM) && position[FROM] >= position[MEMBER]) wiring.delayed.push_back(INDEX);
+        }
     }
+
+    wiring.plan.push_back(step);
   }
-}
 
-void Package::startDispatchThread()
-{
-  if (m_dispatchThreadStarted) return;
+  wiring.planDirty = false;
 
-  spaghetti::log::trace("Starting dispatch thread..");
-  m_dispatchThread = std::thread(&Package::dispatchThreadFunction, this);
-  m_dispatchThreadStarted = true;
+  if (!planFilename.empty()) writePlan(planFilename, KEY);
 }
 
-void Package::quitDispatchThread()
+uint64_t Package::planKey() const
 {
-  if (!m_dispatchThreadStarted) return;
+  // Everything buildPlan() looks at: which slots hold elements and how they are connected. Element types and the
+  // set of registered ones go in as well, so a plugin update never reuses a plan made for other elements.
+  uint64_t key{ 0xcbf29ce484222325 };
+  mix(key, PLAN_VERSION);
+  mix(key, Registry::get().elementsSignature());
 
-  spaghetti::log::trace("Quitting dispatch thread..");
+  mix(key, m_elements.size());
+  for (auto const element : m_elements) mix(key, element ? element->hash() : 0);
 
-  if (m_pause) {
-    spaghetti::log::trace("Dispatch thread paused, waiting..");
-    while (m_pause) std::this_thread::yield();
+  auto const &CONNECTIONS = m_wiring->connections;
+  mix(key, CONNECTIONS.size());
+  for (auto const &CONNECTION : CONNECTIONS) {
+    mix(key, CONNECTION.from_id);
+    mix(key, CONNECTION.from_socket);
+    mix(key, CONNECTION.to_id);
+    mix(key, CONNECTION.to_socket);
   }
 
-  m_quit = true;
-  if (m_dispatchThread.joinable()) {
-    spaghetti::log::trace("Waiting for dispatch thread join..");
-    m_dispatchThread.join();
-    spaghetti::log::trace("After dispatch thread join..");
-  }
-  m_dispatchThreadStarted = false;
+  return key;
 }
 
-void Package::pauseDispatchThread()
+bool Package::readPlan(std::string const &a_filename, uint64_t const a_key) const
 {
-  if (m_package) {
-    m_package->pauseDispatchThread();
-    return;
+  std::ifstream file{ a_filename, std::ios::binary | std::ios::ate };
+  if (!file.is_open()) return false;
+
+  std::vector<uint8_t> buffer(static_cast<size_t>(file.tellg()));
+  file.seekg(0);
+  file.read(reinterpret_cast<char *>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+  if (!file) return false;
+
+  StateReader state{ buffer.data(), buffer.size() };
+  uint32_t magic{};
+  uint32_t version{};
+  uint64_t key{};
+  uint64_t elementsCount{};
+  uint64_t connectionsCount{};
+  state.read(magic, version, key, elementsCount, connectionsCount);
+
+  size_t const COUNT{ m_elements.size() };
+  size_t const CONNECTIONS_COUNT{ m_wiring->connections.size() };
+  if (state.failed() || magic != PLAN_MAGIC || version != PLAN_VERSION || key != a_key || elementsCount != COUNT ||
+      connectionsCount != CONNECTIONS_COUNT)
+    return false;
+
+  // Every index is checked against this package, a damaged file is rebuilt rather than trusted.
+  auto read_indices = [&state](std::vector<size_t> &a_indices, size_t const a_limit) {
+    uint64_t size{};
+    state.read(size);
+    if (state.failed() || size > state.left() / sizeof(uint64_t)) return false;
+
+    a_indices.resize(static_cast<size_t>(size));
+    for (auto &index : a_indices) {
+      uint64_t value{};
+      state.read(value);
+      if (value >= a_limit) return false;
+      index = static_cast<size_t>(value);
+    }
+    return !state.failed();
+  };
+
+  Wiring wiring{};
+  if (!read_indices(wiring.planOrder, COUNT)) return false;
+
+  uint64_t stepsCount{};
+  state.read(stepsCount);
+  if (state.failed() || stepsCount > state.left()) return false;
+  wiring.plan.resize(static_cast<size_t>(stepsCount));
+  size_t planned{};
+  for (auto &step : wiring.plan) {
+    uint64_t first{};
+    uint64_t count{};
+    uint8_t cyclic{};
+    state.read(first, count, cyclic);
+    if (state.failed() || first != planned || count == 0 || count > wiring.planOrder.size() - planned) return false;
+    step = PlanStep{ static_cast<size_t>(first), static_cast<size_t>(count), cyclic != 0 };
+    planned += step.count;
+  }
+  if (planned != wiring.planOrder.size()) return false;
+
+  wiring.incoming.resize(COUNT);
+  for (auto &incoming : wiring.incoming)
+    if (!read_indices(incoming, CONNECTIONS_COUNT)) return false;
+  if (!read_indices(wiring.outgoing, CONNECTIONS_COUNT) || !read_indices(wiring.delayed, CONNECTIONS_COUNT) ||
+      state.left() != 0)
+    return false;
+
+  auto &target = *m_wiring;
+  target.plan = std::move(wiring.plan);
+  target.planOrder = std::move(wiring.planOrder);
+  target.incoming = std::move(wiring.incoming);
+  target.outgoing = std::move(wiring.outgoing);
+  target.delayed = std::move(wiring.delayed);
+
+  log::debug("Reused plan {}", a_filename);
+  return true;
+}
+
+void Package::writePlan(std::string const &a_filename, uint64_t const a_key) const
+{
+  auto const &WIRING = *m_wiring;
+
+  std::vector<uint8_t> buffer{};
+  StateWriter state{ buffer };
+  state.write(PLAN_MAGIC, PLAN_VERSION, a_key, uint64_t{ m_elements.size() }, uint64_t{ WIRING.connections.size() });
+
+  auto write_indices = [&state](std::vector<size_t> const &a_indices) {
+    state.write(uint64_t{ a_indices.size() });
+    for (auto const INDEX : a_indices) state.write(uint64_t{ INDEX });
+  };
+
+  write_indices(WIRING.planOrder);
+  state.write(uint64_t{ WIRING.plan.size() });
+  for (auto const &STEP : WIRING.plan)
+    state.write(uint64_t{ STEP.first }, uint64_t{ STEP.count }, static_cast<uint8_t>(STEP.cyclic));
+  for (auto const &INCOMING : WIRING.incoming) write_indices(INCOMING);
+  write_indices(WIRING.outgoing);
+  write_indices(WIRING.delayed);
+
+  // Runners sharing the cache may write the same plan at once, each one renames its own temporary file.
+  auto const TEMP_FILENAME = a_filename + "." + std::to_string(std::random_device{}()) + ".tmp";
+  try {
+    fs::create_directories(fs::path{ a_filename }.parent_path());
+  } catch (fs::filesystem_error const &a_error) {
+    log::error("Can't create plan cache: {}", a_error.what());
+    return;
+  }
+
+  std::ofstream file{ TEMP_FILENAME, std::ios::binary | std::ios::trunc };
+  if (!file.is_open()) {
+    log::error("Can't open {} for writing", TEMP_FILENAME);
+    return;
+  }
+
+  file.write(reinterpret_cast<char const *>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+  file.close();
+  if (file.fail()) {
+    log::error("Caching plan {} failed", a_filename);
+    std::remove(TEMP_FILENAME.c_str());
+    return;
+  }
+
+  try {
+    fs::rename(TEMP_FILENAME, a_filename);
+  } catch (fs::filesystem_error const &a_error) {
+    log::error("Can't replace {}: {}", a_filename, a_error.what());
+    std::remove(TEMP_FILENAME.c_str());
+  }
+}
+
+void Package::partitionPlan()
+{
+  size_t const STEPS_COUNT{ m_wiring->plan.size() };
+  size_t const PARTITIONS_COUNT{ std::max<size_t>(1, std::min(m_workerCount, STEPS_COUNT)) };
+
+  m_partitionsDirty = false;
+  m_warnedSteps.assign(STEPS_COUNT, false);
+  m_partitions.assign(PARTITIONS_COUNT, {});
+  m_lastOutputs.resize(PARTITIONS_COUNT);
+  m_partitionChanged.assign(PARTITIONS_COUNT, 0);
+  m_cutSlots.assign(m_wiring->connections.size(), -1);
+  m_cutConnections.clear();
+  m_cutValues.clear();
+
+  // Back edges of loops through stateful elements hold last tick's value the same way cut connections do.
+  auto const cut = [this](size_t const a_index) {
+    auto const &CONNECTION = m_wiring->connections[a_index];
+    m_cutSlots[a_index] = static_cast<int32_t>(m_cutConnections.size());
+    m_cutConnections.push_back(a_index);
+    m_cutValues.push_back(m_elements[CONNECTION.from_id]->m_outputs[CONNECTION.from_socket].value);
+  };
+  for (auto const INDEX : m_wiring->delayed) cut(INDEX);
+
+  if (PARTITIONS_COUNT == 1) {
+    for (size_t i = 0; i < STEPS_COUNT; ++i) m_partitions[0].push_back(i);
+    return;
+  }
+
+  // Greedy min-cut: walking steps in topological order, each one joins the partition its inputs mostly come
+  // from, as long as that partition isn't full. Components are never split.
+  size_t const UNASSIGNED{ std::numeric_limits<size_t>::max() };
+  std::vector<size_t> partitionOf(m_elements.size(), UNASSIGNED);
+  std::vector<size_t> loads(PARTITIONS_COUNT);
+  std::vector<size_t> scores(PARTITIONS_COUNT);
+  size_t const CAPACITY{ (m_wiring->planOrder.size() + PARTITIONS_COUNT - 1) / PARTITIONS_COUNT };
+
+  for (size_t stepIndex = 0; stepIndex < STEPS_COUNT; ++stepIndex) {
+    auto const &STEP = m_wiring->plan[stepIndex];
+
+    std::fill(std::begin(scores), std::end(scores), 0);
+    for (size_t i = STEP.first; i < STEP.first + STEP.count; ++i) {
+      for (auto const INDEX : m_wiring->incoming[m_wiring->planOrder[i]]) {
+        auto const FROM = partitionOf[m_wiring->connections[INDEX].from_id];
+        if (FROM != UNASSIGNED) scores[FROM]++;
+      }
+    }
+
+    size_t best{ UNASSIGNED };
+    for (size_t partition = 0; partition < PARTITIONS_COUNT; ++partition) {
+      if (loads[partition] + STEP.count > CAPACITY && loads[partition] > 0) continue;
+      if (best == UNASSIGNED || scores[partition] > scores[best] ||
+          (scores[partition] == scores[best] && loads[partition] < loads[best]))
+        best = partition;
+    }
+    if (best == UNASSIGNED)
+      best = static_cast<size_t>(std::min_element(std::begin(loads), std::end(loads)) - std::begin(loads));
+
+    m_partitions[best].push_back(stepIndex);
+    loads[best] += STEP.count;
+    for (size_t i = STEP.first; i < STEP.first + STEP.count; ++i) partitionOf[m_wiring->planOrder[i]] = best;
+  }
+
+  size_t const CONNECTIONS_COUNT{ m_wiring->connections.size() };
+  for (size_t i = 0; i < CONNECTIONS_COUNT; ++i) {
+    auto const &CONNECTION = m_wiring->connections[i];
+    if (CONNECTION.from_id == 0 || CONNECTION.to_id == 0) continue;
+    if (CONNECTION.from_id >= m_elements.size() || CONNECTION.to_id >= m_elements.size()) continue;
+    if (partitionOf[CONNECTION.from_id] == partitionOf[CONNECTION.to_id] || m_cutSlots[i] >= 0) continue;
+
+    cut(i);
+  }
+
+  log::debug("Partitioned {} elements into {} parts, {} connections cross partitions", m_wiring->planOrder.size(),
+             PARTITIONS_COUNT, m_cutConnections.size() - m_wiring->delayed.size());
+}
+
+void Package::setWorkerCount(size_t const a_count)
+{
+  pauseDispatchThread();
+
+  stopWorkers();
+  m_workerCount = std::max<size_t>(1, a_count);
+  m_partitionsDirty = true;
+
+  resumeDispatchThread();
+}
+
+void Package::startWorkers()
+{
+  // Workers are started by the first tick that has partitions for them, copies that never run (snapshots,
+  // prototypes) don't get any.
+  if (m_workers.empty()) m_stopWorkers = false;
+  for (size_t partition = m_workers.size() + 1; partition < m_partitions.size(); ++partition)
+    m_workers.emplace_back(&Package::workerThreadFunction, this, partition, m_workGeneration);
+}
+
+void Package::stopWorkers()
+{
+  if (m_workers.empty()) return;
+
+  {
+    std::lock_guard<std::mutex> lock{ m_workMutex };
+    m_stopWorkers = true;
+  }
+  m_workCondition.notify_all();
+
+  for (auto &&worker : m_workers) worker.join();
+  m_workers.clear();
+}
+
+void Package::workerThreadFunction(size_t const a_partition, uint64_t const a_generation)
+{
+  uint64_t generation{ a_generation };
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock{ m_workMutex };
+      m_workCondition.wait(lock, [&] { return m_stopWorkers || m_workGeneration != generation; });
+      if (m_stopWorkers) return;
+      generation = m_workGeneration;
+    }
+
+    if (a_partition < m_partitions.size()) runPartition(a_partition);
+
+    {
+      std::lock_guard<std::mutex> lock{ m_workMutex };
+      m_pendingWorkers--;
+    }
+    m_workDoneCondition.notify_one();
+  }
+}
+
+void Package::setRateDivisor(uint32_t const a_divisor)
+{
+  m_rateDivisor = std::max(a_divisor, uint32_t{ 1 });
+  m_skippedTicks = 0;
+  touch();
+}
+
+void Package::copyContents(Package const &a_other)
+{
+  pauseDispatchThread();
+
+  size_t const SIZE{ a_other.m_elements.size() };
+  for (size_t i = 1; i < m_elements.size(); ++i) delete m_elements[i];
+  m_elements.resize(1);
+  m_elements.reserve(SIZE);
+
+  for (size_t i = 1; i < SIZE; ++i) {
+    auto const SOURCE = a_other.m_elements[i];
+    Element *const element{ SOURCE ? SOURCE->clone() : nullptr };
+    m_elements.push_back(element);
+    if (element == nullptr) continue;
+
+    element->m_package = this;
+    element->m_id = i;
+    element->reset();
+  }
+
+  m_free = a_other.m_free;
+  for (auto &&generation : m_generations) generation++;
+  m_generations.resize(std::max(m_generations.size(), SIZE));
+  m_deadlines.clear();
+  m_events = EventQueue{};
+
+  // The element layout is identical, so the wiring can be shared until one of the packages changes it.
+  if (a_other.m_wiring->planDirty) a_other.buildPlan();
+  m_wiring = a_other.m_wiring;
+  m_partitionsDirty = true;
+
+  resumeDispatchThread();
+}
+
+void Package::saveState(StateWriter &a_state) const
+{
+  uint32_t count{};
+  size_t const SIZE{ m_elements.size() };
+  for (size_t i = 1; i < SIZE; ++i) count += m_elements[i] != nullptr;
+
+  a_state.write(m_delta, m_skippedTicks, m_changed, count);
+  for (size_t i = 1; i < SIZE; ++i) {
+    if (m_elements[i] == nullptr) continue;
+
+    a_state.write(static_cast<uint64_t>(i));
+    save_element(a_state, *m_elements[i]);
+  }
+}
+
+void Package::loadState(StateReader &a_state)
+{
+  uint32_t count{};
+  a_state.read(m_delta, m_skippedTicks, m_changed, count);
+
+  for (uint32_t i = 0; i < count && !a_state.failed(); ++i) {
+    uint64_t id{};
+    a_state.read(id);
+    if (id == 0 || id >= m_elements.size() || m_elements[id] == nullptr) {
+      a_state.fail();
+      return;
+    }
+
+    load_element(a_state, *m_elements[id]);
+  }
+
+  // Values crossing partitions are cached, take them from the restored outputs.
+  m_partitionsDirty = true;
+}
+
+Element::duration_t Package::timeToWakeUp() const
+{
+  // Timers write their outputs straight from the wheel, a package between its runs keeps ticking until the next
+  // one so what they wrote gets through in time.
+  if (m_changed || m_skippedTicks != 0) return duration_t::zero();
+
+  duration_t wakeUp{ m_package ? duration_t::max() : m_timerWheel.timeToNextExpiry() };
+  for (auto &&element : m_elements) {
+    if (!element || element == this) continue;
+    wakeUp = std::min(wakeUp, element->timeToWakeUp());
+  }
+
+  return wakeUp;
+}
+
+Element *Package::add(string::hash_t const a_hash)
+{
+  pauseDispatchThread();
+
+  spaghetti::log::debug("Adding element..");
+
+  spaghetti::Registry &registry{ spaghetti::Registry::get() };
+
+  Element *const element{ registry.createElement(a_hash) };
+  assert(element);
+
+  size_t index{};
+  if (m_free.empty()) {
+    index = m_elements.size();
+    m_elements.emplace_back(element);
+    if (index == m_generations.size()) m_generations.push_back(0);
+  } else {
+    index = m_free.back();
+    assert(m_elements[index] == nullptr);
+    m_elements[index] = element;
+    m_free.pop_back();
+  }
+
+  element->m_package = this;
+  element->m_id = index;
+  element->reset();
+  invalidatePlan();
+
+  resumeDispatchThread();
+
+  return element;
+}
+
+void Package::remove(size_t const a_id)
+{
+  pauseDispatchThread();
+
+  spaghetti::log::debug("Removing element {}..", a_id);
+
+  assert(a_id > 0);
+  assert(a_id < m_elements.size());
+  assert(m_elements[a_id] != nullptr);
+
+  delete m_elements[a_id];
+  m_elements[a_id] = nullptr;
+  m_generations[a_id]++;
+  m_free.emplace_back(a_id);
+  invalidatePlan();
+
+  resumeDispatchThread();
+}
+
+Element *Package::get(size_t const a_id) const
+{
+  assert(a_id < m_elements.size());
+  assert(m_elements[a_id] != nullptr);
+  return m_elements[a_id];
+}
+
+Element *Package::get(Handle const &a_handle) const
+{
+  if (a_handle.id >= m_elements.size() || m_generations[a_handle.id] != a_handle.generation) return nullptr;
+  return m_elements[a_handle.id];
+}
+
+Package::Handle Package::handle(size_t const a_id) const
+{
+  assert(a_id < m_elements.size());
+  return Handle{ a_id, m_generations[a_id] };
+}
+
+void Package::compact()
+{
+  if (m_free.empty()) return;
+
+  pauseDispatchThread();
+
+  size_t const OLD_SIZE{ m_elements.size() };
+  std::vector<size_t> newIds(OLD_SIZE);
+  Elements elements{};
+  elements.reserve(OLD_SIZE - m_free.size());
+
+  for (size_t i = 0; i < OLD_SIZE; ++i) {
+    auto const element = m_elements[i];
+    if (element == nullptr) continue;
+
+    newIds[i] = elements.size();
+    element->m_id = newIds[i];
+    elements.push_back(element);
+  }
+
+  // Every slot whose occupant changed gets a new generation, including the ones past the new end.
+  for (size_t i = 0; i < OLD_SIZE; ++i)
+    if (i >= elements.size() || elements[i] != m_elements[i]) m_generations[i]++;
+
+  unshareWiring();
+
+  auto &connections = m_wiring->connections;
+  auto const IT = std::remove_if(std::begin(connections), std::end(connections), [this](auto const &a_connection) {
+    return m_elements[a_connection.from_id] == nullptr || m_elements[a_connection.to_id] == nullptr;
+  });
+  connections.erase(IT, std::end(connections));
+
+  for (auto &&connection : connections) {
+    connection.from_id = newIds[connection.from_id];
+    connection.to_id = newIds[connection.to_id];
+
+    Element *const target{ elements[connection.to_id] };
+    auto &targetIo = connection.to_id != 0 ? target->m_inputs : target->m_outputs;
+    targetIo[connection.to_socket].id = connection.from_id;
+  }
+
+  log::debug("Compacted package from {} to {} slots", OLD_SIZE, elements.size());
+
+  m_elements = std::move(elements);
+  rebuildConnectionIndex();
+  m_free.clear();
+  m_deadlines.clear();
+  m_events = EventQueue{};
+  invalidatePlan();
+
+  // Ids no longer match what the journal knows, the next save writes the file whole.
+  m_journal.base.clear();
+
+  resumeDispatchThread();
+}
+
+bool Package::connect(size_t const a_sourceId, uint8_t const a_sourceSocket, size_t const a_targetId,
+                      uint8_t const a_targetSocket)
+{
+  pauseDispatchThread();
+
+  auto const source = get(a_sourceId);
+  auto const target = get(a_targetId);
+
+  spaghetti::log::debug("Connecting source: {}@{} to target: {}@{}", a_sourceId, static_cast<int>(a_sourceSocket),
+                        a_targetId, static_cast<int>(a_targetSocket));
+
+  auto const &SOURCE = a_sourceId != 0 ? source->m_outputs : source->m_inputs;
+  auto &TARGET = a_targetId != 0 ? target->m_inputs : target->m_outputs;
+  auto const SOURCE_SIZE = SOURCE.size();
+  auto const TARGET_SIZE = TARGET.size();
+  assert(a_sourceSocket < SOURCE_SIZE && "Socket ID don't exist");
+  assert(a_targetSocket < TARGET_SIZE && "Socket ID don't exist");
+
+  TARGET[a_targetSocket].id = a_sourceId;
+  TARGET[a_targetSocket].slot = a_sourceSocket;
+
+  spaghetti::log::debug("Notifying {}({})@{} when {}({})@{} changes..", a_targetId, target->name(),
+                        static_cast<int32_t>(a_targetSocket), a_sourceId, source->name(),
+                        static_cast<int32_t>(a_sourceSocket));
+
+  // A socket has a single driver, connecting it again replaces the previous link.
+  auto const DRIVER = driverOf(a_targetId, a_targetSocket);
+  if (DRIVER != NO_CONNECTION) eraseConnection(DRIVER);
+
+  addConnection(Connection{ a_sourceId, a_sourceSocket, a_targetId, a_targetSocket });
+  invalidatePlan();
+
+  resumeDispatchThread();
+
+  return true;
+}
+
+bool Package::disconnect(size_t const a_sourceId, uint8_t const a_outputId, size_t const a_targetId,
+                         uint8_t const a_inputId)
+{
+  pauseDispatchThread();
+
+  Element *const target{ get(a_targetId) };
+
+  spaghetti::log::debug("Disconnecting source: {}@{} from target: {}@{}", a_sourceId, static_cast<int>(a_outputId),
+                        a_targetId, static_cast<int>(a_inputId));
+
+  auto const INDEX = driverOf(a_targetId, a_inputId);
+  if (INDEX != NO_CONNECTION && m_wiring->connections[INDEX].from_id == a_sourceId &&
+      m_wiring->connections[INDEX].from_socket == a_outputId)
+    eraseConnection(INDEX);
+
+  auto &targetInput = a_targetId != 0 ? target->m_inputs[a_inputId] : target->m_outputs[a_inputId];
+  targetInput.id = 0;
+  targetInput.slot = 0;
+  resetIOSocketValue(targetInput);
+  invalidatePlan();
+
+  resumeDispatchThread();
+
+  return true;
+}
+
+size_t Package::driverOf(size_t const a_targetId, uint8_t const a_targetSocket) const
+{
+  auto const IT = m_wiring->drivers.find(socketKey(a_targetId, a_targetSocket));
+  return IT == std::end(m_wiring->drivers) ? NO_CONNECTION : IT->second;
+}
+
+std::vector<size_t> const &Package::fanOutOf(size_t const a_sourceId, uint8_t const a_sourceSocket) const
+{
+  static std::vector<size_t> const s_empty{};
+  auto const IT = m_wiring->fanOuts.find(socketKey(a_sourceId, a_sourceSocket));
+  return IT == std::end(m_wiring->fanOuts) ? s_empty : IT->second;
+}
+
+void Package::addConnection(Connection const &a_connection)
+{
+  unshareWiring();
+
+  size_t const INDEX{ m_wiring->connections.size() };
+  auto &fanOut = m_wiring->fanOuts[socketKey(a_connection.from_id, a_connection.from_socket)];
+
+  m_wiring->connections.push_back(a_connection);
+  m_wiring->fanOutSlots.push_back(fanOut.size());
+  fanOut.push_back(INDEX);
+  m_wiring->drivers[socketKey(a_connection.to_id, a_connection.to_socket)] = INDEX;
+}
+
+void Package::eraseConnection(size_t const a_index)
+{
+  unshareWiring();
+
+  auto const &CONNECTION = m_wiring->connections[a_index];
+
+  auto &fanOut = m_wiring->fanOuts[socketKey(CONNECTION.from_id, CONNECTION.from_socket)];
+  auto const SLOT = m_wiring->fanOutSlots[a_index];
+  fanOut[SLOT] = fanOut.back();
+  m_wiring->fanOutSlots[fanOut[SLOT]] = SLOT;
+  fanOut.pop_back();
+  m_wiring->drivers.erase(socketKey(CONNECTION.to_id, CONNECTION.to_socket));
+
+  size_t const LAST{ m_wiring->connections.size() - 1 };
+  if (a_index != LAST) {
+    auto const &MOVED = m_wiring->connections[LAST];
+    m_wiring->drivers[socketKey(MOVED.to_id, MOVED.to_socket)] = a_index;
+    m_wiring->fanOuts[socketKey(MOVED.from_id, MOVED.from_socket)][m_wiring->fanOutSlots[LAST]] = a_index;
+    m_wiring->connections[a_index] = MOVED;
+    m_wiring->fanOutSlots[a_index] = m_wiring->fanOutSlots[LAST];
+  }
+
+  m_wiring->connections.pop_back();
+  m_wiring->fanOutSlots.pop_back();
+}
+
+void Package::unshareWiring()
+{
+  if (m_wiring.use_count() > 1) m_wiring = std::make_shared<Wiring>(*m_wiring);
+}
+
+void Package::invalidatePlan()
+{
+  unshareWiring();
+  m_wiring->planDirty = true;
+  m_partitionsDirty = true;
+  touch();
+}
+
+void Package::rebuildConnectionIndex()
+{
+  unshareWiring();
+
+  Connections connections{};
+  std::swap(connections, m_wiring->connections);
+
+  m_wiring->drivers.clear();
+  m_wiring->fanOuts.clear();
+  m_wiring->fanOutSlots.clear();
+  for (auto const &CONNECTION : connections) addConnection(CONNECTION);
+}
+
+void Package::dispatchThreadFunction()
+{
+  using clock_t = std::chrono::high_resolution_clock;
+
+  auto const ONE_MILLISECOND = std::chrono::milliseconds(1);
+
+  auto last = clock_t::now() - ONE_MILLISECOND;
+
+  while (!m_quit) {
+    auto const NOW = clock_t::now();
+    auto const DELTA = NOW - last;
+
+    update(DELTA);
+    calculate();
+
+    last = NOW;
+
+    auto const WAKE_UP = timeToWakeUp();
+    if (WAKE_UP > ONE_MILLISECOND) {
+      std::unique_lock<std::mutex> lock{ m_wakeUpMutex };
+      auto const WOKEN_UP = [this] { return m_wakeUp || m_pause || m_quit; };
+      if (WAKE_UP == duration_t::max())
+        m_wakeUpCondition.wait(lock, WOKEN_UP);
+      else
+        m_wakeUpCondition.wait_for(lock, WAKE_UP, WOKEN_UP);
+      m_wakeUp = false;
+    } else {
+      auto const WAIT_START = clock_t::now();
+      while ((clock_t::now() - WAIT_START) < ONE_MILLISECOND) std::this_thread::sleep_for(ONE_MILLISECOND);
+    }
+
+    if (m_pause) {
+      spaghetti::log::trace("Pause requested..");
+      m_paused = true;
+      spaghetti::log::trace("Pausing..");
+      while (m_pause) std::this_thread::yield();
+      m_paused = false;
+      spaghetti::log::trace("Pause stopped..");
+    }
+  }
+}
+
+void Package::runFor(duration_t const &a_time)
+{
+  assert(m_package == nullptr && "Only root package can be simulated");
+
+  pauseDispatchThread();
+
+  auto const END = m_simulationTime + a_time;
+
+  settle(duration_t::zero());
+  scheduleWakeUps();
+
+  while (true) {
+    while (!m_events.empty() && m_events.top().time != m_deadlines[m_events.top().id]) m_events.pop();
+
+    auto next = m_events.empty() ? duration_t::max() : m_events.top().time;
+    auto const TIMER = m_timerWheel.timeToNextExpiry();
+    if (TIMER != duration_t::max()) next = std::min(next, m_simulationTime + TIMER);
+    if (next > END) break;
+
+    settle(next - m_simulationTime);
+    m_simulationTime = next;
+
+    while (!m_events.empty() && m_events.top().time <= m_simulationTime) m_events.pop();
+    scheduleWakeUps();
+  }
+
+  if (END > m_simulationTime) {
+    settle(END - m_simulationTime);
+    m_simulationTime = END;
+    scheduleWakeUps();
+  }
+
+  resumeDispatchThread();
+}
+
+void Package::settle(duration_t const &a_delta)
+{
+  size_t const MAX_ITERATIONS{ 1000 };
+
+  update(a_delta);
+  calculate();
+
+  size_t iterations{ 1 };
+  for (; m_changed && iterations < MAX_ITERATIONS; ++iterations) {
+    update(duration_t::zero());
+    calculate();
+  }
+
+  if (m_changed) log::warn("Package didn't settle after {} iterations at {}ms", iterations, m_simulationTime.count());
+}
+
+void Package::scheduleWakeUps()
+{
+  size_t const SIZE{ m_elements.size() };
+  m_deadlines.resize(SIZE, duration_t::max());
+
+  for (size_t i = 1; i < SIZE; ++i) {
+    auto const element = m_elements[i];
+    if (element == nullptr) {
+      m_deadlines[i] = duration_t::max();
+      continue;
+    }
+
+    auto const WAKE_UP = element->timeToWakeUp();
+    auto const DEADLINE =
+        WAKE_UP == duration_t::max() ? WAKE_UP : m_simulationTime + std::max(WAKE_UP, m_simulationStep);
+    if (DEADLINE == m_deadlines[i]) continue;
+
+    m_deadlines[i] = DEADLINE;
+    if (DEADLINE != duration_t::max()) m_events.push(ScheduledEvent{ DEADLINE, i });
+  }
+}
+
+void Package::startDispatchThread()
+{
+  if (m_dispatchThreadStarted) return;
+
+  spaghetti::log::trace("Starting dispatch thread..");
+  m_dispatchThread = std::thread(&Package::dispatchThreadFunction, this);
+  m_dispatchThreadStarted = true;
+}
+
+void Package::quitDispatchThread()
+{
+  if (!m_dispatchThreadStarted) return;
+
+  spaghetti::log::trace("Quitting dispatch thread..");
+
+  if (m_pause) {
+    spaghetti::log::trace("Dispatch thread paused, waiting..");
+    while (m_pause) std::this_thread::yield();
+  }
+
+  m_quit = true;
+  wakeDispatchThread();
+  if (m_dispatchThread.joinable()) {
+    spaghetti::log::trace("Waiting for dispatch thread join..");
+    m_dispatchThread.join();
+    spaghetti::log::trace("After dispatch thread join..");
+  }
+  m_dispatchThreadStarted = false;
+}
+
+void Package::pauseDispatchThread()
+{
+  if (m_package) {
+    m_package->pauseDispatchThread();
+    return;
   }
 
   if (!m_dispatchThreadStarted) return;
@@ -393,6 +1499,7 @@ void Package::pauseDispatchThread()
   if (m_pauseCount > 1) return;
 
   m_pause = true;
+  wakeDispatchThread();
 
   spaghetti::log::trace("Pausing dispatch thread ({})..", m_pauseCount.load());
   while (!m_paused) std::this_thread::yield();
@@ -418,23 +1525,74 @@ void Package::resumeDispatchThread()
   m_pause = false;
 }
 
+void Package::wakeDispatchThread()
+{
+  if (m_package) {
+    m_package->wakeDispatchThread();
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock{ m_wakeUpMutex };
+    m_wakeUp = true;
+  }
+  m_wakeUpCondition.notify_one();
+}
+
 void Package::open(std::string const &a_filename)
 {
   spaghetti::log::debug("Opening package {}", a_filename);
 
-  std::ifstream file{ a_filename };
-  if (!file.is_open()) return;
+  auto const FORMAT = PackageFile::detect(a_filename);
+  bool const IS_EMPTY{ m_elements.size() == 1 };
+
+  Json journaled{};
+  bool const REPLAYED{ PackageJournal::replay(a_filename, journaled) };
+
+  if (REPLAYED) {
+    pauseDispatchThread();
+    deserialize(journaled);
+  } else if (PackageBundle::isMember(a_filename)) {
+    Json json{};
+    if (!PackageBundle::read(a_filename, json)) return;
+
+    pauseDispatchThread();
+    deserialize(json);
+  } else if (FORMAT == PackageFile::Format::eBinary) {
+    PackageFile file{};
+    if (!file.open(a_filename)) return;
+
+    pauseDispatchThread();
+    load(file);
+  } else if (FORMAT == PackageFile::Format::eJson) {
+    std::ifstream file{ a_filename };
+    if (!file.is_open()) return;
 
-  pauseDispatchThread();
+    pauseDispatchThread();
+    load(file);
+  } else {
+    Json json{};
+    if (!PackageFile::read(a_filename, json)) return;
 
-  Json json{};
-  file >> json;
+    pauseDispatchThread();
+    deserialize(json);
+  }
 
-  deserialize(json);
+  m_fileFormat = FORMAT;
 
   m_isExternal = m_package != nullptr;
   spaghetti::log::debug("{} Is external: {}", a_filename, m_isExternal);
 
+  // Loading into an empty package puts each element at its position in the file, which is how the journal refers
+  // to them. A replayed journal is folded into the file by the next save instead.
+  m_journal.base.clear();
+  if (m_journaling && m_package == nullptr && IS_EMPTY && !REPLAYED &&
+      std::find(m_elements.begin() + 1, m_elements.end(), nullptr) == m_elements.end()) {
+    std::vector<size_t> fileIds(m_elements.size());
+    std::iota(fileIds.begin(), fileIds.end(), size_t{});
+    resetJournal(a_filename, fileIds);
+  }
+
   resumeDispatchThread();
 }
 
@@ -442,30 +1600,579 @@ void Package::save(std::string const &a_filename)
 {
   spaghetti::log::debug("Saving package {}", a_filename);
 
+  if (appendJournal(a_filename)) return;
+
+  if (m_journaling)
+    rewrite(a_filename).wait();
+  else
+    snapshot()->write(a_filename);
+}
+
+std::future<bool> Package::saveAsync(std::string const &a_filename)
+{
+  spaghetti::log::debug("Saving package {} in background", a_filename);
+
+  if (appendJournal(a_filename)) {
+    std::promise<bool> saved{};
+    saved.set_value(true);
+    return saved.get_future();
+  }
+
+  if (m_journaling) {
+    auto const REWRITTEN = rewrite(a_filename);
+    return std::async(std::launch::deferred, [REWRITTEN] { return REWRITTEN.get(); });
+  }
+
+  auto const SNAPSHOT = snapshot();
+  return std::async(std::launch::async, [SNAPSHOT, a_filename] { return SNAPSHOT->write(a_filename); });
+}
+
+void Package::resetJournal(std::string const &a_base, std::vector<size_t> const &a_fileIds)
+{
+  m_journal.base = a_base;
+  m_journal.started = false;
+  m_journal.nextFileId = 1;
+
+  size_t const SIZE{ m_elements.size() };
+  m_journal.slots.assign(SIZE, JournalSlot{});
+  for (size_t i = 1; i < SIZE; ++i) {
+    auto const element = m_elements[i];
+    if (element == nullptr) continue;
+
+    m_journal.slots[i] = JournalSlot{ element->serial(), element->revision(), 0, a_fileIds[i] };
+    m_journal.nextFileId = std::max(m_journal.nextFileId, a_fileIds[i] + 1);
+  }
+
+  m_journal.wiring = m_wiring;
+  m_journal.connections = journalConnections();
+  m_journal.header = Json{};
+  serializeHeader(m_journal.header);
+}
+
+bool Package::appendJournal(std::string const &a_filename)
+{
+  if (!m_journaling || m_package != nullptr || m_journal.base != a_filename) return false;
+
+  // The journal continues from the file a pending rewrite is putting in place.
+  if (m_journal.pending.valid()) {
+    bool const REWRITTEN{ m_journal.pending.get() };
+    m_journal.pending = std::shared_future<bool>{};
+    if (!REWRITTEN) m_journal.base.clear();
+  }
+
+  if (!m_journal.base.empty() && !m_journal.started) m_journal.started = PackageJournal::start(a_filename);
+  if (m_journal.base.empty() || !m_journal.started) {
+    m_journal.base.clear();
+    return false;
+  }
+
   pauseDispatchThread();
 
-  Json json{};
-  serialize(json);
+  std::vector<Json> entries{};
+  auto &slots = m_journal.slots;
+  size_t const SIZE{ m_elements.size() };
+  slots.resize(std::max(slots.size(), SIZE));
+
+  bool relinked{};
+  size_t const SLOTS_SIZE{ slots.size() };
+  for (size_t i = 1; i < SLOTS_SIZE; ++i) {
+    Element *const element{ i < SIZE ? m_elements[i] : nullptr };
+    auto &slot = slots[i];
+
+    if (slot.fileId != 0 && (element == nullptr || element->serial() != slot.serial)) {
+      Json entry{};
+      entry["remove"] = slot.fileId;
+      entries.push_back(std::move(entry));
+      slot = JournalSlot{};
+      relinked = true;
+    }
+    if (element == nullptr) continue;
+
+    bool const ADDED{ slot.fileId == 0 };
+    if (ADDED) {
+      slot.fileId = m_journal.nextFileId++;
+      slot.serial = element->serial();
+      relinked = true;
+    } else if (element->revision() == slot.revision) {
+      continue;
+    }
+
+    slot.revision = element->revision();
+    auto jsonElement = serialize_element(*element, slot.fileId);
+    auto const JSON_HASH = hash_text(jsonElement.dump());
+    if (!ADDED && JSON_HASH == slot.hash) continue;
+    slot.hash = JSON_HASH;
+
+    Json entry{};
+    entry["set"] = std::move(jsonElement);
+    entries.push_back(std::move(entry));
+  }
+
+  if (relinked || m_wiring != m_journal.wiring) {
+    auto connections = journalConnections();
+    Connections changed{};
+    std::set_difference(m_journal.connections.begin(), m_journal.connections.end(), connections.begin(),
+                        connections.end(), std::back_inserter(changed), connection_less);
+    for (auto const &CONNECTION : changed) entries.push_back(connection_entry("disconnect", CONNECTION));
+    changed.clear();
+    std::set_difference(connections.begin(), connections.end(), m_journal.connections.begin(),
+                        m_journal.connections.end(), std::back_inserter(changed), connection_less);
+    for (auto const &CONNECTION : changed) entries.push_back(connection_entry("connect", CONNECTION));
+
+    m_journal.connections = std::move(connections);
+    m_journal.wiring = m_wiring;
+  }
+
+  Json header{};
+  serializeHeader(header);
+  if (header != m_journal.header) {
+    Json entry{};
+    entry["header"] = header;
+    entries.push_back(std::move(entry));
+    m_journal.header = std::move(header);
+  }
+
+  resumeDispatchThread();
+
+  if (entries.empty()) return true;
+
+  if (!PackageJournal::append(a_filename, entries)) {
+    m_journal.base.clear();
+    return false;
+  }
+
+  log::debug("Journaled {} changes to {}", entries.size(), a_filename);
+
+  size_t fileSize{};
+  try {
+    fileSize = static_cast<size_t>(fs::file_size(a_filename));
+  } catch (fs::filesystem_error const &) {
+  }
+  if (PackageJournal::size(a_filename) > std::max(fileSize / 2, JOURNAL_MIN_REWRITE_SIZE)) rewrite(a_filename);
+
+  return true;
+}
+
+std::shared_future<bool> Package::rewrite(std::string const &a_filename)
+{
+  if (m_journal.pending.valid()) m_journal.pending.wait();
+
+  pauseDispatchThread();
+  auto const SNAPSHOT = snapshot();
+  resetJournal(a_filename, dense_ids(m_elements));
+  resumeDispatchThread();
+
+  // The journal starts over only once the new file is in place, a crash in between leaves one that doesn't match
+  // the file and gets ignored.
+  m_journal.started = true;
+  auto const REWRITE = [SNAPSHOT, a_filename] {
+    return SNAPSHOT->write(a_filename) && PackageJournal::start(a_filename);
+  };
+  m_journal.pending = std::async(std::launch::async, REWRITE).share();
+
+  return m_journal.pending;
+}
+
+Package::Connections Package::journalConnections() const
+{
+  Connections connections{};
+  connections.reserve(m_wiring->connections.size());
+
+  auto const FILE_ID = [this](size_t const a_id) {
+    return a_id < m_journal.slots.size() ? m_journal.slots[a_id].fileId : size_t{};
+  };
+  for (auto const &CONNECTION : m_wiring->connections) {
+    auto connection = CONNECTION;
+    connection.from_id = FILE_ID(CONNECTION.from_id);
+    connection.to_id = FILE_ID(CONNECTION.to_id);
+    connections.push_back(connection);
+  }
+
+  std::sort(connections.begin(), connections.end(), connection_less);
+  return connections;
+}
 
-  std::ofstream file{ a_filename };
-  file << json.dump(2);
+std::vector<uint8_t> Package::checkpoint()
+{
+  assert(m_package == nullptr && "Only root package can be checkpointed");
+
+  pauseDispatchThread();
+
+  std::vector<uint8_t> checkpoint{};
+  StateWriter state{ checkpoint };
+  state.write(CHECKPOINT_MAGIC, CHECKPOINT_VERSION, layout_signature(*this), m_simulationTime, m_timerWheel.now());
+  save_element(state, *this);
+
+  resumeDispatchThread();
+
+  return checkpoint;
+}
+
+bool Package::restore(std::vector<uint8_t> const &a_checkpoint)
+{
+  assert(m_package == nullptr && "Only root package can be restored");
+
+  StateReader state{ a_checkpoint.data(), a_checkpoint.size() };
+  uint32_t magic{};
+  uint32_t version{};
+  uint64_t signature{};
+  duration_t simulationTime{};
+  duration_t timerWheelNow{};
+  state.read(magic, version, signature, simulationTime, timerWheelNow);
+  if (state.failed() || magic != CHECKPOINT_MAGIC || version != CHECKPOINT_VERSION) {
+    log::error("Not a simulation checkpoint");
+    return false;
+  }
+
+  pauseDispatchThread();
+
+  if (signature != layout_signature(*this)) {
+    resumeDispatchThread();
+    log::error("Checkpoint was taken from a package with a different layout");
+    return false;
+  }
+
+  // Timer elements re-arm while loading, relative to the restored clock.
+  m_timerWheel.reset(timerWheelNow);
+  load_element(state, *this);
+
+  m_simulationTime = simulationTime;
+  m_deadlines.clear();
+  m_events = EventQueue{};
+  m_changed = true;
+
+  resumeDispatchThread();
+
+  if (state.failed()) {
+    log::error("Checkpoint is truncated, the simulation state is incomplete");
+    return false;
+  }
+
+  return true;
+}
+
+bool Package::saveCheckpoint(std::string const &a_filename)
+{
+  spaghetti::log::debug("Saving checkpoint {}", a_filename);
+
+  auto const CHECKPOINT = checkpoint();
+  auto const TEMP_FILENAME = a_filename + ".tmp";
+
+  std::ofstream file{ TEMP_FILENAME, std::ios::binary | std::ios::trunc };
+  if (!file.is_open()) {
+    log::error("Can't open {} for writing", TEMP_FILENAME);
+    return false;
+  }
+
+  file.write(reinterpret_cast<char const *>(CHECKPOINT.data()), static_cast<std::streamsize>(CHECKPOINT.size()));
+  file.close();
+  if (file.fail()) {
+    log::error("Saving {} failed", a_filename);
+    std::remove(TEMP_FILENAME.c_str());
+    return false;
+  }
+
+  try {
+    fs::rename(TEMP_FILENAME, a_filename);
+  } catch (fs::filesystem_error const &a_error) {
+    log::error("Can't replace {}: {}", a_filename, a_error.what());
+    return false;
+  }
+
+  return true;
+}
+
+bool Package::loadCheckpoint(std::string const &a_filename)
+{
+  spaghetti::log::debug("Loading checkpoint {}", a_filename);
+
+  std::ifstream file{ a_filename, std::ios::binary | std::ios::ate };
+  if (!file.is_open()) {
+    log::error("Can't open {}", a_filename);
+    return false;
+  }
+
+  std::vector<uint8_t> checkpoint(static_cast<size_t>(file.tellg()));
+  file.seekg(0);
+  file.read(reinterpret_cast<char *>(checkpoint.data()), static_cast<std::streamsize>(checkpoint.size()));
+  if (!file) {
+    log::error("Can't read {}", a_filename);
+    return false;
+  }
+
+  return restore(checkpoint);
+}
+
+std::shared_ptr<Package::Snapshot const> Package::snapshot()
+{
+  pauseDispatchThread();
+
+  if (m_wiring->planDirty) buildPlan();
+  auto const SNAPSHOT = takeSnapshot();
 
   resumeDispatchThread();
+
+  return SNAPSHOT;
+}
+
+std::shared_ptr<Package::Snapshot const> Package::takeSnapshot()
+{
+  auto const snapshot = std::make_shared<Snapshot>();
+  serializeHeader(snapshot->m_header);
+  snapshot->m_fileFormat = m_fileFormat;
+  snapshot->m_simulationTime = m_simulationTime;
+  snapshot->m_isExternal = m_isExternal;
+
+  // The wiring is copy-on-write already, the next edit of this package leaves the snapshot's copy alone.
+  snapshot->m_wiring = m_wiring;
+
+  size_t const SIZE{ m_elements.size() };
+  m_snapshotSlots.resize(SIZE);
+  snapshot->m_elements.resize(SIZE);
+  snapshot->m_packages.resize(SIZE);
+  for (size_t i = 1; i < SIZE; ++i) {
+    auto const element = m_elements[i];
+    auto &slot = m_snapshotSlots[i];
+    if (element == nullptr) {
+      slot = SnapshotSlot{};
+      continue;
+    }
+
+    auto const REVISION = element->revision();
+    bool const CHANGED{ slot.serial != element->serial() || slot.revision != REVISION };
+    if (element->hash() == HASH) {
+      // Any change inside bumps the package's revision, its snapshot then reuses the copies of what didn't change.
+      if (!slot.package || CHANGED) {
+        slot = SnapshotSlot{};
+        slot.package = static_cast<Package *>(element)->takeSnapshot();
+      }
+      snapshot->m_packages[i] = slot.package;
+    } else {
+      if (!slot.copy || CHANGED) {
+        slot = SnapshotSlot{};
+        slot.copy.reset(element->clone());
+      }
+      snapshot->m_elements[i] = slot.copy;
+    }
+    slot.serial = element->serial();
+    slot.revision = REVISION;
+  }
+
+  return snapshot;
+}
+
+std::vector<size_t> Package::Snapshot::denseIds() const
+{
+  size_t const DATA_SIZE{ m_elements.size() };
+  std::vector<size_t> denseIds(DATA_SIZE);
+  size_t nextId{ 1 };
+  for (size_t i = 1; i < DATA_SIZE; ++i)
+    if (m_elements[i] || m_packages[i]) denseIds[i] = nextId++;
+  return denseIds;
+}
+
+Package::Snapshot::Json Package::Snapshot::serializeElement(size_t const a_id, size_t const a_denseId) const
+{
+  if (m_elements[a_id]) return serialize_element(*m_elements[a_id], a_denseId);
+
+  Json jsonElement{};
+  m_packages[a_id]->serialize(jsonElement);
+  jsonElement["element"]["id"] = a_denseId;
+  return jsonElement;
+}
+
+void Package::Snapshot::serialize(Json &a_json) const
+{
+  a_json = m_header;
+  if (m_isExternal) return;
+
+  auto const DENSE_IDS = denseIds();
+
+  auto jsonElements = Json::array();
+  size_t const DATA_SIZE{ m_elements.size() };
+  for (size_t i = 1; i < DATA_SIZE; ++i)
+    if (DENSE_IDS[i] != 0) jsonElements.push_back(serializeElement(i, DENSE_IDS[i]));
+  a_json["package"]["elements"] = jsonElements;
+
+  auto jsonConnections = Json::array();
+  for (auto const &CONNECTION : m_wiring->connections)
+    jsonConnections.push_back(serialize_connection(CONNECTION, DENSE_IDS));
+  a_json["package"]["connections"] = jsonConnections;
+}
+
+bool Package::Snapshot::write(std::string const &a_filename) const
+{
+  auto const FORMAT = PackageFile::formatFor(a_filename, m_fileFormat);
+
+  // Written next to the target and moved over it once complete, an interrupted save leaves the old file intact.
+  auto const TEMP_FILENAME = a_filename + ".tmp";
+
+  bool written{};
+  if (FORMAT == PackageFile::Format::eJson) {
+    std::vector<char> buffer(1 << 16);
+    std::ofstream file{};
+    file.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    file.open(TEMP_FILENAME, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      log::error("Can't open {} for writing", TEMP_FILENAME);
+      return false;
+    }
+
+    writeJson(file);
+    file.close();
+    written = !file.fail();
+  } else {
+    Json json{};
+    serialize(json);
+    written = PackageFile::write(TEMP_FILENAME, json, FORMAT);
+  }
+
+  if (!written) {
+    log::error("Saving {} failed", a_filename);
+    std::remove(TEMP_FILENAME.c_str());
+    return false;
+  }
+
+  try {
+    fs::rename(TEMP_FILENAME, a_filename);
+  } catch (fs::filesystem_error const &a_error) {
+    log::error("Can't replace {}: {}", a_filename, a_error.what());
+    return false;
+  }
+
+  return true;
+}
+
+void Package::Snapshot::writeJson(std::ostream &a_stream) const
+{
+  if (m_isExternal) {
+    a_stream << m_header.dump();
+    return;
+  }
+
+  // Only the header is a Json tree, elements and connections are serialized and written one at a time.
+  Json root = m_header;
+  auto const jsonPackage = std::move(root["package"]);
+  root.erase("package");
+
+  auto write_fields = [&a_stream](Json const &a_object) {
+    for (auto it = a_object.begin(); it != a_object.end(); ++it)
+      a_stream << Json(it.key()).dump() << ':' << it.value().dump() << ',';
+  };
+
+  a_stream << '{';
+  write_fields(root);
+  a_stream << "\"package\":{";
+  write_fields(jsonPackage);
+
+  auto const DENSE_IDS = denseIds();
+
+  a_stream << "\"elements\":[";
+  char const *separator{ "" };
+  size_t const DATA_SIZE{ m_elements.size() };
+  for (size_t i = 1; i < DATA_SIZE; ++i) {
+    if (DENSE_IDS[i] == 0) continue;
+    a_stream << separator << serializeElement(i, DENSE_IDS[i]).dump();
+    separator = ",";
+  }
+
+  a_stream << "],\"connections\":[";
+  separator = "";
+  for (auto const &CONNECTION : m_wiring->connections) {
+    a_stream << separator << serialize_connection(CONNECTION, DENSE_IDS).dump();
+    separator = ",";
+  }
+  a_stream << "]}}";
+}
+
+void Package::load(PackageFile const &a_file)
+{
+  // Elements are created straight from the file's records, only one of them is ever held as Json.
+  deserialize(a_file.root());
+
+  std::map<size_t, size_t> remappedIds{};
+
+  size_t const ELEMENTS_COUNT{ a_file.elementsCount() };
+  for (size_t i = 0; i < ELEMENTS_COUNT; ++i) {
+    auto const JSON = a_file.element(i);
+    auto const &ELEMENT_GROUP = JSON["element"];
+    auto const ELEMENT_TYPE = ELEMENT_GROUP["type"].get<std::string>();
+    auto const element = add(ELEMENT_TYPE.c_str());
+    auto const ELEMENT_ID = ELEMENT_GROUP["id"].get<size_t>();
+    element->deserialize(JSON);
+
+    remappedIds[ELEMENT_ID] = element->id();
+  }
+
+  size_t const CONNECTIONS_COUNT{ a_file.connectionsCount() };
+  for (size_t i = 0; i < CONNECTIONS_COUNT; ++i) {
+    auto const CONNECTION = a_file.connection(i);
+    connect(remappedIds[CONNECTION.from_id], CONNECTION.from_socket, remappedIds[CONNECTION.to_id],
+            CONNECTION.to_socket);
+  }
+}
+
+void Package::load(std::istream &a_stream)
+{
+  // Root elements are created as soon as their object is parsed and then dropped from the document, connections
+  // are put aside until all ids are known. The Json never holds more than the root and the element being read.
+  std::map<size_t, size_t> remappedIds{};
+  Connections connections{};
+  std::string keys[3]{};
+
+  auto const CALLBACK = [&](int const a_depth, Json::parse_event_t const a_event, Json &a_parsed) {
+    if (a_event == Json::parse_event_t::key) {
+      if (a_depth < 3) keys[a_depth] = a_parsed.get<std::string>();
+      return true;
+    }
+
+    // Objects directly inside the root's "package" arrays end at depth 3.
+    if (a_event != Json::parse_event_t::object_end || a_depth != 3 || keys[1] != "package") return true;
+
+    if (keys[2] == "elements") {
+      auto const &ELEMENT_GROUP = a_parsed["element"];
+      auto const ELEMENT_TYPE = ELEMENT_GROUP["type"].get<std::string>();
+      auto const element = add(ELEMENT_TYPE.c_str());
+      auto const ELEMENT_ID = ELEMENT_GROUP["id"].get<size_t>();
+      element->deserialize(a_parsed);
+
+      remappedIds[ELEMENT_ID] = element->id();
+      return false;
+    }
+
+    if (keys[2] == "connections") {
+      auto const &FROM = a_parsed["connect"];
+      auto const &TO = a_parsed["to"];
+      connections.push_back(Connection{ FROM["id"].get<size_t>(), FROM["socket"].get<uint8_t>(),
+                                        TO["id"].get<size_t>(), TO["socket"].get<uint8_t>() });
+      return false;
+    }
+
+    return true;
+  };
+
+  auto const JSON = Json::parse(a_stream, CALLBACK);
+  deserialize(JSON);
+
+  for (auto const &CONNECTION : connections)
+    connect(remappedIds[CONNECTION.from_id], CONNECTION.from_socket, remappedIds[CONNECTION.to_id],
+            CONNECTION.to_socket);
 }
 
 Registry::PackageInfo Package::getInfoFor(std::string const &a_filename)
 {
   Registry::PackageInfo type{};
 
-  std::ifstream file{ a_filename };
-  if (!file.is_open()) return type;
-
   Json json{};
-  file >> json;
 
+  // Edits still in a journal may have changed the header, such packages are read whole.
+  if (!PackageJournal::replay(a_filename, json) && !PackageFile::readRoot(a_filename, json)) return type;
+  if (!json.is_object() || json.count("package") == 0) return type;
+
+  auto const &PACKAGE = json["package"];
   type.filename = a_filename;
-  type.icon = json["package"]["icon"];
-  type.path = json["package"]["path"];
+  type.icon = PACKAGE.value("icon", std::string{});
+  type.path = PACKAGE.value("path", std::string{});
 
   return type;
 }
@@ -0,0 +1,319 @@
+// MIT License
+//
+// Copyright (c) 2017-2018 Artur Wyszyński, aljen at hitomi dot pl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "spaghetti/package_bundle.h"
+
+// clang-format off
+#if !defined(_WIN64) && !defined(_WIN32)
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+# define SPAGHETTI_HAS_MMAP 1
+#endif
+// clang-format on
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <map>
+
+#include "spaghetti/logger.h"
+#include "spaghetti/package_file.h"
+
+#include "filesystem.h"
+
+namespace spaghetti {
+
+namespace {
+
+// Values are in host (little endian) order, offsets of strings and documents are relative to the data section.
+struct Header {
+  uint32_t magic{};
+  uint16_t version{};
+  uint16_t flags{};
+  uint32_t entriesCount{};
+  uint32_t padding{};
+  uint64_t entriesOffset{};
+  uint64_t dataOffset{};
+  uint64_t dataSize{};
+};
+
+// The icon follows the path in the data section, entries are sorted by path.
+struct EntryRecord {
+  uint64_t pathOffset{};
+  uint64_t documentOffset{};
+  uint64_t documentSize{};
+  uint32_t pathSize{};
+  uint32_t iconSize{};
+};
+
+static_assert(sizeof(Header) == 40);
+static_assert(sizeof(EntryRecord) == 32);
+
+std::string const MEMBER_MARK{ std::string{ PackageBundle::EXTENSION } + PackageBundle::SEPARATOR };
+
+} // namespace
+
+PackageBundle::~PackageBundle()
+{
+  close();
+}
+
+std::string PackageBundle::memberFilename(std::string const &a_bundle, std::string const &a_path)
+{
+  return a_bundle + SEPARATOR + a_path;
+}
+
+bool PackageBundle::split(std::string const &a_filename, std::string &a_bundle, std::string &a_path)
+{
+  auto const MARK = a_filename.find(MEMBER_MARK);
+  if (MARK == std::string::npos) return false;
+
+  auto const SEPARATOR_POSITION = MARK + MEMBER_MARK.size() - 1;
+  a_bundle = a_filename.substr(0, SEPARATOR_POSITION);
+  a_path = a_filename.substr(SEPARATOR_POSITION + 1);
+  return true;
+}
+
+bool PackageBundle::isMember(std::string const &a_filename)
+{
+  return a_filename.find(MEMBER_MARK) != std::string::npos;
+}
+
+bool PackageBundle::read(std::string const &a_filename, Json &a_json)
+{
+  std::string bundleFilename{};
+  std::string path{};
+  if (!split(a_filename, bundleFilename, path)) return false;
+
+  PackageBundle bundle{};
+  if (!bundle.open(bundleFilename)) return false;
+  if (bundle.find(path, a_json)) return true;
+
+  log::error("{} has no package registered as '{}'", bundleFilename, path);
+  return false;
+}
+
+bool PackageBundle::write(std::string const &a_filename, std::vector<std::string> const &a_packages)
+{
+  struct BundledPackage {
+    std::string icon{};
+    std::vector<uint8_t> document{};
+  };
+  std::map<std::string, BundledPackage> packages{};
+
+  for (auto const &FILENAME : a_packages) {
+    Json json{};
+    if (!PackageFile::read(FILENAME, json)) return false;
+    if (!json.is_object() || json.count("package") == 0) {
+      log::error("{} is not a package", FILENAME);
+      return false;
+    }
+
+    auto const &PACKAGE = json["package"];
+    auto const PATH = PACKAGE.value("path", std::string{});
+    if (PATH.empty()) {
+      log::error("{} isn't registered under any path", FILENAME);
+      return false;
+    }
+
+    auto &package = packages[PATH];
+    package.icon = PACKAGE.value("icon", std::string{});
+    package.document = Json::to_cbor(json);
+  }
+
+  // Strings and documents are laid out in path order, the same order as the index.
+  std::vector<EntryRecord> entries{};
+  std::vector<uint8_t> data{};
+  auto append = [&data](auto const &a_bytes) {
+    auto const OFFSET = static_cast<uint64_t>(data.size());
+    data.insert(std::end(data), std::begin(a_bytes), std::end(a_bytes));
+    return OFFSET;
+  };
+
+  for (auto const &[PATH, PACKAGE] : packages) {
+    EntryRecord entry{};
+    entry.pathOffset = append(PATH);
+    entry.pathSize = static_cast<uint32_t>(PATH.size());
+    append(PACKAGE.icon);
+    entry.iconSize = static_cast<uint32_t>(PACKAGE.icon.size());
+    entry.documentOffset = append(PACKAGE.document);
+    entry.documentSize = static_cast<uint64_t>(PACKAGE.document.size());
+    entries.push_back(entry);
+  }
+
+  Header header{};
+  header.magic = MAGIC;
+  header.version = VERSION;
+  header.entriesCount = static_cast<uint32_t>(entries.size());
+  header.entriesOffset = sizeof(Header);
+  header.dataOffset = header.entriesOffset + entries.size() * sizeof(EntryRecord);
+  header.dataSize = static_cast<uint64_t>(data.size());
+
+  auto const TEMP_FILENAME = a_filename + ".tmp";
+  std::ofstream file{ TEMP_FILENAME, std::ios::binary | std::ios::trunc };
+  if (!file.is_open()) {
+    log::error("Can't open {} for writing", TEMP_FILENAME);
+    return false;
+  }
+
+  file.write(reinterpret_cast<char const *>(&header), sizeof(header));
+  file.write(reinterpret_cast<char const *>(entries.data()),
+             static_cast<std::streamsize>(entries.size() * sizeof(EntryRecord)));
+  file.write(reinterpret_cast<char const *>(data.data()), static_cast<std::streamsize>(data.size()));
+  file.close();
+  if (file.fail()) {
+    log::error("Writing bundle {} failed", a_filename);
+    std::remove(TEMP_FILENAME.c_str());
+    return false;
+  }
+
+  try {
+    fs::rename(TEMP_FILENAME, a_filename);
+  } catch (fs::filesystem_error const &a_error) {
+    log::error("Can't replace {}: {}", a_filename, a_error.what());
+    return false;
+  }
+
+  log::info("Bundled {} packages into {}", packages.size(), a_filename);
+  return true;
+}
+
+bool PackageBundle::open(std::string const &a_filename)
+{
+  close();
+
+#ifdef SPAGHETTI_HAS_MMAP
+  int const FD{ ::open(a_filename.c_str(), O_RDONLY) };
+  if (FD < 0) {
+    log::error("Can't open {}", a_filename);
+    return false;
+  }
+
+  struct stat info {};
+  if (::fstat(FD, &info) == 0 && info.st_size > 0) {
+    void *const DATA{ ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, FD, 0) };
+    if (DATA != MAP_FAILED) {
+      m_data = static_cast<uint8_t const *>(DATA);
+      m_size = static_cast<size_t>(info.st_size);
+      m_mapped = true;
+    }
+  }
+  ::close(FD);
+#else
+  std::ifstream file{ a_filename, std::ios::binary };
+  if (!file.is_open()) {
+    log::error("Can't open {}", a_filename);
+    return false;
+  }
+  m_buffer.assign(std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{});
+  if (!m_buffer.empty()) {
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+  }
+#endif
+
+  auto invalid = [&](char const *const a_reason) {
+    log::error("{} is not a valid bundle: {}", a_filename, a_reason);
+    close();
+    return false;
+  };
+
+  if (m_data == nullptr || m_size < sizeof(Header)) return invalid("too short");
+
+  auto const &HEADER = *reinterpret_cast<Header const *>(m_data);
+  if (HEADER.magic != MAGIC) return invalid("wrong magic");
+  if (HEADER.version != VERSION) return invalid("unsupported version");
+  if (HEADER.entriesOffset % alignof(uint64_t) != 0 || HEADER.entriesOffset > m_size ||
+      HEADER.entriesCount > (m_size - HEADER.entriesOffset) / sizeof(EntryRecord) || HEADER.dataOffset > m_size ||
+      HEADER.dataSize > m_size - HEADER.dataOffset)
+    return invalid("index out of bounds");
+
+  // Entries are checked once here, lookups then read them directly.
+  auto const ENTRIES = reinterpret_cast<EntryRecord const *>(m_data + HEADER.entriesOffset);
+  for (uint32_t i = 0; i < HEADER.entriesCount; ++i) {
+    auto const &RECORD = ENTRIES[i];
+    uint64_t const STRINGS_SIZE{ uint64_t{ RECORD.pathSize } + RECORD.iconSize };
+    if (RECORD.pathOffset > HEADER.dataSize || STRINGS_SIZE > HEADER.dataSize - RECORD.pathOffset ||
+        RECORD.documentOffset > HEADER.dataSize || RECORD.documentSize > HEADER.dataSize - RECORD.documentOffset)
+      return invalid("entry out of bounds");
+    if (i > 0 && !(entry(i - 1).path < entry(i).path)) return invalid("index not sorted");
+  }
+
+  return true;
+}
+
+void PackageBundle::close()
+{
+#ifdef SPAGHETTI_HAS_MMAP
+  if (m_mapped) ::munmap(const_cast<uint8_t *>(m_data), m_size);
+#endif
+  m_data = nullptr;
+  m_size = 0;
+  m_buffer.clear();
+  m_mapped = false;
+}
+
+size_t PackageBundle::size() const
+{
+  if (!isOpen()) return 0;
+  return reinterpret_cast<Header const *>(m_data)->entriesCount;
+}
+
+PackageBundle::Entry PackageBundle::entry(size_t const a_index) const
+{
+  auto const &HEADER = *reinterpret_cast<Header const *>(m_data);
+  auto const &RECORD = reinterpret_cast<EntryRecord const *>(m_data + HEADER.entriesOffset)[a_index];
+  auto const PATH = reinterpret_cast<char const *>(m_data + HEADER.dataOffset + RECORD.pathOffset);
+  return Entry{ std::string_view{ PATH, RECORD.pathSize },
+                std::string_view{ PATH + RECORD.pathSize, RECORD.iconSize } };
+}
+
+bool PackageBundle::find(std::string_view const a_path, Json &a_json) const
+{
+  if (!isOpen()) return false;
+
+  size_t first{};
+  size_t count{ size() };
+  while (count > 0) {
+    size_t const STEP{ count / 2 };
+    if (entry(first + STEP).path < a_path) {
+      first += STEP + 1;
+      count -= STEP + 1;
+    } else
+      count = STEP;
+  }
+
+  if (first == size() || entry(first).path != a_path) return false;
+
+  auto const &HEADER = *reinterpret_cast<Header const *>(m_data);
+  auto const &RECORD = reinterpret_cast<EntryRecord const *>(m_data + HEADER.entriesOffset)[first];
+  auto const DOCUMENT = m_data + HEADER.dataOffset + RECORD.documentOffset;
+  a_json = Json::from_cbor(DOCUMENT, DOCUMENT + RECORD.documentSize);
+  return true;
+}
+
+} // namespace spaghetti
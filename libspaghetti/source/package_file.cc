@@ -0,0 +1,866 @@
+// MIT License
+//
+// Copyright (c) 2017-2018 Artur Wyszyński, aljen at hitomi dot pl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "spaghetti/package_file.h"
+
+// clang-format off
+#if !defined(_WIN64) && !defined(_WIN32)
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+# define SPAGHETTI_HAS_MMAP 1
+#endif
+// clang-format on
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <unordered_map>
+
+#include "spaghetti/logger.h"
+
+namespace spaghetti {
+
+namespace {
+
+// All tables are 8 byte aligned so records can be read in place, values are in host (little endian) order.
+struct Header {
+  uint32_t magic{};
+  uint16_t version{};
+  uint16_t flags{};
+  uint32_t stringsCount{};
+  uint32_t elementsCount{};
+  uint32_t socketsCount{};
+  uint32_t connectionsCount{};
+  uint64_t stringsOffset{};
+  uint64_t elementsOffset{};
+  uint64_t socketsOffset{};
+  uint64_t connectionsOffset{};
+  uint64_t dataOffset{};
+  uint64_t dataSize{};
+};
+
+// Offsets of strings and CBOR blobs are relative to the data section.
+struct StringRecord {
+  uint64_t offset{};
+  uint64_t size{};
+};
+
+struct ElementRecord {
+  enum Flags : uint8_t { eRaw = 1 << 0, eIconify = 1 << 1, eIconifyingHidesCentralWidget = 1 << 2 };
+
+  uint64_t id{};
+  double x{};
+  double y{};
+  uint64_t extraOffset{};
+  uint64_t extraSize{};
+  uint32_t type{};
+  uint32_t name{};
+  uint32_t firstSocket{};
+  uint8_t inputs{};
+  uint8_t outputs{};
+  uint8_t minInputs{};
+  uint8_t maxInputs{};
+  uint8_t minOutputs{};
+  uint8_t maxOutputs{};
+  uint8_t defaultNewInputFlags{};
+  uint8_t defaultNewOutputFlags{};
+  uint8_t flags{};
+  uint8_t padding[3]{};
+};
+
+struct SocketRecord {
+  uint32_t name{};
+  uint8_t type{};
+  uint8_t flags{};
+  uint8_t padding[2]{};
+};
+
+struct ConnectionRecord {
+  uint64_t fromId{};
+  uint64_t toId{};
+  uint8_t fromSocket{};
+  uint8_t toSocket{};
+  uint8_t padding[6]{};
+};
+
+static_assert(sizeof(Header) == 72);
+static_assert(sizeof(StringRecord) == 16);
+static_assert(sizeof(ElementRecord) == 64);
+static_assert(sizeof(SocketRecord) == 8);
+static_assert(sizeof(ConnectionRecord) == 24);
+
+std::array<char const *, 3> const SOCKET_TYPES{ { "bool", "int", "float" } };
+
+using Json = PackageFile::Json;
+
+template<typename Strings>
+Json assemble(ElementRecord const &a_record, SocketRecord const *const a_sockets, Strings &&a_strings, Json a_json)
+{
+  auto &jsonElement = a_json["element"];
+  jsonElement["id"] = a_record.id;
+  jsonElement["name"] = a_strings(a_record.name);
+  jsonElement["type"] = a_strings(a_record.type);
+  jsonElement["min_inputs"] = a_record.minInputs;
+  jsonElement["max_inputs"] = a_record.maxInputs;
+  jsonElement["min_outputs"] = a_record.minOutputs;
+  jsonElement["max_outputs"] = a_record.maxOutputs;
+  jsonElement["default_new_input_flags"] = a_record.defaultNewInputFlags;
+  jsonElement["default_new_output_flags"] = a_record.defaultNewOutputFlags;
+
+  auto sockets = [&](size_t const a_first, size_t const a_count) {
+    auto jsonSockets = Json::array();
+    for (size_t i = 0; i < a_count; ++i) {
+      auto const &SOCKET = a_sockets[a_first + i];
+      Json socket{};
+      socket["socket"] = i;
+      socket["type"] = SOCKET_TYPES[SOCKET.type];
+      socket["name"] = a_strings(SOCKET.name);
+      socket["flags"] = SOCKET.flags;
+      jsonSockets.push_back(socket);
+    }
+    return jsonSockets;
+  };
+
+  auto &jsonIo = jsonElement["io"];
+  jsonIo["inputs"] = sockets(0, a_record.inputs);
+  jsonIo["outputs"] = sockets(a_record.inputs, a_record.outputs);
+
+  auto &jsonNode = a_json["node"];
+  jsonNode["position"]["x"] = a_record.x;
+  jsonNode["position"]["y"] = a_record.y;
+  jsonNode["iconify"] = (a_record.flags & ElementRecord::eIconify) != 0;
+  jsonNode["iconifying_hides_central_widget"] = (a_record.flags & ElementRecord::eIconifyingHidesCentralWidget) != 0;
+
+  return a_json;
+}
+
+bool get_unsigned(Json const &a_object, char const *const a_key, uint64_t const a_max, uint64_t &a_value)
+{
+  auto const IT = a_object.find(a_key);
+  if (IT == std::end(a_object) || !IT->is_number_unsigned()) return false;
+  a_value = IT->get<uint64_t>();
+  return a_value <= a_max;
+}
+
+template<typename T>
+bool get_byte(Json const &a_object, char const *const a_key, T &a_value)
+{
+  uint64_t value{};
+  if (!get_unsigned(a_object, a_key, 255, value)) return false;
+  a_value = static_cast<T>(value);
+  return true;
+}
+
+bool get_string(Json const &a_object, char const *const a_key, std::string &a_value)
+{
+  auto const IT = a_object.find(a_key);
+  if (IT == std::end(a_object) || !IT->is_string()) return false;
+  a_value = IT->get<std::string>();
+  return true;
+}
+
+class Writer {
+ public:
+  void addElement(Json const &a_json)
+  {
+    if (!addRecord(a_json)) addRaw(a_json);
+  }
+
+  void addRaw(Json const &a_json)
+  {
+    ElementRecord record{};
+    record.flags = ElementRecord::eRaw;
+    addBlob(a_json, record.extraOffset, record.extraSize);
+    m_elements.push_back(record);
+  }
+
+  bool addConnections(Json const &a_connections)
+  {
+    std::vector<ConnectionRecord> connections{};
+    connections.reserve(a_connections.size());
+
+    auto endpoint = [](Json const &a_connection, char const *const a_key, uint64_t &a_id, uint8_t &a_socket) {
+      auto const IT = a_connection.find(a_key);
+      if (IT == std::end(a_connection) || !IT->is_object() || IT->size() != 2) return false;
+      return get_unsigned(*IT, "id", std::numeric_limits<uint64_t>::max(), a_id) && get_byte(*IT, "socket", a_socket);
+    };
+
+    for (auto const &CONNECTION : a_connections) {
+      if (!CONNECTION.is_object() || CONNECTION.size() != 2) return false;
+
+      ConnectionRecord record{};
+      if (!endpoint(CONNECTION, "connect", record.fromId, record.fromSocket)) return false;
+      if (!endpoint(CONNECTION, "to", record.toId, record.toSocket)) return false;
+      connections.push_back(record);
+    }
+
+    m_connections = std::move(connections);
+    return true;
+  }
+
+  std::vector<uint8_t> finish() const
+  {
+    Header header{};
+    header.magic = PackageFile::MAGIC;
+    header.version = PackageFile::VERSION;
+    header.stringsCount = static_cast<uint32_t>(m_strings.size());
+    header.elementsCount = static_cast<uint32_t>(m_elements.size());
+    header.socketsCount = static_cast<uint32_t>(m_sockets.size());
+    header.connectionsCount = static_cast<uint32_t>(m_connections.size());
+    header.stringsOffset = sizeof(Header);
+    header.elementsOffset = header.stringsOffset + m_strings.size() * sizeof(StringRecord);
+    header.socketsOffset = header.elementsOffset + m_elements.size() * sizeof(ElementRecord);
+    header.connectionsOffset = header.socketsOffset + m_sockets.size() * sizeof(SocketRecord);
+    header.dataOffset = header.connectionsOffset + m_connections.size() * sizeof(ConnectionRecord);
+    header.dataSize = m_data.size();
+
+    std::vector<uint8_t> buffer{};
+    buffer.reserve(header.dataOffset + header.dataSize);
+
+    auto append = [&buffer](void const *const a_data, size_t const a_size) {
+      auto const DATA = static_cast<uint8_t const *>(a_data);
+      buffer.insert(std::end(buffer), DATA, DATA + a_size);
+    };
+
+    append(&header, sizeof(header));
+    append(m_strings.data(), m_strings.size() * sizeof(StringRecord));
+    append(m_elements.data(), m_elements.size() * sizeof(ElementRecord));
+    append(m_sockets.data(), m_sockets.size() * sizeof(SocketRecord));
+    append(m_connections.data(), m_connections.size() * sizeof(ConnectionRecord));
+    append(m_data.data(), m_data.size());
+
+    return buffer;
+  }
+
+ private:
+  bool addRecord(Json const &a_json)
+  {
+    if (!a_json.is_object()) return false;
+
+    auto const ELEMENT_IT = a_json.find("element");
+    auto const NODE_IT = a_json.find("node");
+    if (ELEMENT_IT == std::end(a_json) || !ELEMENT_IT->is_object()) return false;
+    if (NODE_IT == std::end(a_json) || !NODE_IT->is_object()) return false;
+    auto const &ELEMENT = *ELEMENT_IT;
+    auto const &NODE = *NODE_IT;
+
+    ElementRecord record{};
+    std::string name{}, type{};
+    if (!get_unsigned(ELEMENT, "id", std::numeric_limits<uint64_t>::max(), record.id)) return false;
+    if (!get_string(ELEMENT, "name", name) || !get_string(ELEMENT, "type", type)) return false;
+    if (!get_byte(ELEMENT, "min_inputs", record.minInputs) || !get_byte(ELEMENT, "max_inputs", record.maxInputs))
+      return false;
+    if (!get_byte(ELEMENT, "min_outputs", record.minOutputs) || !get_byte(ELEMENT, "max_outputs", record.maxOutputs))
+      return false;
+    if (!get_byte(ELEMENT, "default_new_input_flags", record.defaultNewInputFlags)) return false;
+    if (!get_byte(ELEMENT, "default_new_output_flags", record.defaultNewOutputFlags)) return false;
+
+    auto const IO_IT = ELEMENT.find("io");
+    if (IO_IT == std::end(ELEMENT) || !IO_IT->is_object() || IO_IT->size() != 2) return false;
+    auto const INPUTS_IT = IO_IT->find("inputs");
+    auto const OUTPUTS_IT = IO_IT->find("outputs");
+    if (INPUTS_IT == std::end(*IO_IT) || OUTPUTS_IT == std::end(*IO_IT)) return false;
+
+    std::vector<SocketRecord> sockets{};
+    auto add_sockets = [&](Json const &a_sockets, uint8_t &a_count) {
+      if (!a_sockets.is_array() || a_sockets.size() > 255) return false;
+      a_count = static_cast<uint8_t>(a_sockets.size());
+      for (size_t i = 0; i < a_sockets.size(); ++i) {
+        auto const &SOCKET = a_sockets[i];
+        if (!SOCKET.is_object() || SOCKET.size() != 4) return false;
+
+        uint64_t index{};
+        std::string socketType{}, socketName{};
+        SocketRecord socket{};
+        if (!get_unsigned(SOCKET, "socket", 255, index) || index != i) return false;
+        if (!get_string(SOCKET, "type", socketType) || !get_string(SOCKET, "name", socketName)) return false;
+        if (!get_byte(SOCKET, "flags", socket.flags)) return false;
+
+        auto const TYPE_IT = std::find(std::begin(SOCKET_TYPES), std::end(SOCKET_TYPES), socketType);
+        if (TYPE_IT == std::end(SOCKET_TYPES)) return false;
+        socket.type = static_cast<uint8_t>(std::distance(std::begin(SOCKET_TYPES), TYPE_IT));
+        socket.name = addString(socketName);
+        sockets.push_back(socket);
+      }
+      return true;
+    };
+    if (!add_sockets(*INPUTS_IT, record.inputs) || !add_sockets(*OUTPUTS_IT, record.outputs)) return false;
+
+    auto const POSITION_IT = NODE.find("position");
+    if (POSITION_IT == std::end(NODE) || !POSITION_IT->is_object() || POSITION_IT->size() != 2) return false;
+    auto const X_IT = POSITION_IT->find("x");
+    auto const Y_IT = POSITION_IT->find("y");
+    if (X_IT == std::end(*POSITION_IT) || !X_IT->is_number_float()) return false;
+    if (Y_IT == std::end(*POSITION_IT) || !Y_IT->is_number_float()) return false;
+    record.x = X_IT->get<double>();
+    record.y = Y_IT->get<double>();
+
+    auto const ICONIFY_IT = NODE.find("iconify");
+    auto const HIDES_IT = NODE.find("iconifying_hides_central_widget");
+    if (ICONIFY_IT == std::end(NODE) || !ICONIFY_IT->is_boolean()) return false;
+    if (HIDES_IT == std::end(NODE) || !HIDES_IT->is_boolean()) return false;
+    if (ICONIFY_IT->get<bool>()) record.flags |= ElementRecord::eIconify;
+    if (HIDES_IT->get<bool>()) record.flags |= ElementRecord::eIconifyingHidesCentralWidget;
+
+    record.name = addString(name);
+    record.type = addString(type);
+
+    Json extra = a_json;
+    auto &extraElement = extra["element"];
+    for (auto const KEY : { "id", "name", "type", "min_inputs", "max_inputs", "min_outputs", "max_outputs",
+                            "default_new_input_flags", "default_new_output_flags", "io" })
+      extraElement.erase(KEY);
+    if (extraElement.empty()) extra.erase("element");
+    auto &extraNode = extra["node"];
+    for (auto const KEY : { "position", "iconify", "iconifying_hides_central_widget" }) extraNode.erase(KEY);
+    if (extraNode.empty()) extra.erase("node");
+
+    // Whatever the checks above missed shows up here, such an element is stored whole instead.
+    auto const STRINGS = [this](uint32_t const a_index) { return m_stringValues[a_index]; };
+    if (assemble(record, sockets.data(), STRINGS, extra) != a_json) return false;
+
+    record.firstSocket = static_cast<uint32_t>(m_sockets.size());
+    m_sockets.insert(std::end(m_sockets), std::begin(sockets), std::end(sockets));
+    if (!extra.empty()) addBlob(extra, record.extraOffset, record.extraSize);
+    m_elements.push_back(record);
+    return true;
+  }
+
+  uint32_t addString(std::string const &a_string)
+  {
+    auto const IT = m_stringIndices.find(a_string);
+    if (IT != std::end(m_stringIndices)) return IT->second;
+
+    auto const INDEX = static_cast<uint32_t>(m_strings.size());
+    m_strings.push_back(StringRecord{ m_data.size(), a_string.size() });
+    m_stringValues.push_back(a_string);
+    m_stringIndices[a_string] = INDEX;
+    m_data.insert(std::end(m_data), std::begin(a_string), std::end(a_string));
+    return INDEX;
+  }
+
+  void addBlob(Json const &a_json, uint64_t &a_offset, uint64_t &a_size)
+  {
+    auto const CBOR = Json::to_cbor(a_json);
+    a_offset = m_data.size();
+    a_size = CBOR.size();
+    m_data.insert(std::end(m_data), std::begin(CBOR), std::end(CBOR));
+  }
+
+ private:
+  std::vector<StringRecord> m_strings{};
+  std::vector<std::string> m_stringValues{};
+  std::unordered_map<std::string, uint32_t> m_stringIndices{};
+  std::vector<ElementRecord> m_elements{};
+  std::vector<SocketRecord> m_sockets{};
+  std::vector<ConnectionRecord> m_connections{};
+  std::vector<uint8_t> m_data{};
+};
+
+bool fits(uint64_t const a_offset, uint64_t const a_count, uint64_t const a_size, uint64_t const a_total)
+{
+  if (a_offset > a_total || a_offset % alignof(uint64_t) != 0) return false;
+  return a_count <= (a_total - a_offset) / a_size;
+}
+
+// Just enough of a JSON reader to step over values without building them, used to get at the package header
+// without paying for its elements. Positions past the end mean the text is malformed.
+class JsonSkipper final {
+ public:
+  explicit JsonSkipper(std::string_view const a_text)
+    : m_text{ a_text }
+  {
+  }
+
+  bool done() const { return m_position >= m_text.size(); }
+
+  bool expect(char const a_character)
+  {
+    skipWhitespace();
+    if (done() || m_text[m_position] != a_character) return false;
+    m_position++;
+    return true;
+  }
+
+  bool peek(char const a_character)
+  {
+    skipWhitespace();
+    return !done() && m_text[m_position] == a_character;
+  }
+
+  // Raw contents of the next string, escapes are left as they are.
+  bool key(std::string_view &a_key)
+  {
+    skipWhitespace();
+    size_t const START{ m_position + 1 };
+    if (!skipString()) return false;
+    a_key = m_text.substr(START, m_position - START - 1);
+    return expect(':');
+  }
+
+  bool value(std::string_view &a_value)
+  {
+    skipWhitespace();
+    size_t const START{ m_position };
+    if (!skipValue()) return false;
+    a_value = m_text.substr(START, m_position - START);
+    return true;
+  }
+
+ private:
+  void skipWhitespace()
+  {
+    while (!done() && std::isspace(static_cast<unsigned char>(m_text[m_position]))) m_position++;
+  }
+
+  bool skipString()
+  {
+    if (done() || m_text[m_position] != '"') return false;
+
+    for (m_position++; !done(); m_position++) {
+      if (m_text[m_position] == '\\')
+        m_position++;
+      else if (m_text[m_position] == '"')
+        break;
+    }
+    if (done()) return false;
+
+    m_position++;
+    return true;
+  }
+
+  bool skipValue()
+  {
+    if (done()) return false;
+
+    char const FIRST{ m_text[m_position] };
+    if (FIRST == '"') return skipString();
+
+    if (FIRST != '{' && FIRST != '[') {
+      while (!done() && std::strchr(",}] \t\r\n", m_text[m_position]) == nullptr) m_position++;
+      return !done();
+    }
+
+    size_t depth{};
+    while (!done()) {
+      char const CHARACTER{ m_text[m_position] };
+      if (CHARACTER == '"') {
+        if (!skipString()) return false;
+        continue;
+      }
+
+      m_position++;
+      if (CHARACTER == '{' || CHARACTER == '[')
+        depth++;
+      else if ((CHARACTER == '}' || CHARACTER == ']') && --depth == 0)
+        return true;
+    }
+
+    return false;
+  }
+
+ private:
+  std::string_view m_text{};
+  size_t m_position{};
+};
+
+// Parses the members of the object at a_skipper, stepping over those named in a_skipped. The package object is
+// descended into with a_nested.
+bool read_members(JsonSkipper &a_skipper, Json &a_json, std::string_view const a_nested,
+                  std::initializer_list<std::string_view> const a_skipped)
+{
+  if (!a_skipper.expect('{')) return false;
+  a_json = Json::object();
+  if (a_skipper.expect('}')) return true;
+
+  do {
+    std::string_view key{};
+    if (!a_skipper.key(key)) return false;
+
+    if (!a_nested.empty() && key == a_nested && a_skipper.peek('{')) {
+      if (!read_members(a_skipper, a_json[std::string{ key }], {}, a_skipped)) return false;
+      continue;
+    }
+
+    std::string_view value{};
+    if (!a_skipper.value(value)) return false;
+    if (std::find(a_skipped.begin(), a_skipped.end(), key) != a_skipped.end()) {
+      a_json[std::string{ key }] = Json::array();
+      continue;
+    }
+
+    auto parsed = Json::parse(value.begin(), value.end(), nullptr, false);
+    if (parsed.is_discarded()) return false;
+    a_json[std::string{ key }] = std::move(parsed);
+  } while (a_skipper.expect(','));
+
+  return a_skipper.expect('}');
+}
+
+} // namespace
+
+PackageFile::~PackageFile()
+{
+  close();
+}
+
+PackageFile::Format PackageFile::formatFor(std::string const &a_filename, Format const a_default)
+{
+  std::string_view const FILENAME{ a_filename };
+  auto has_extension = [FILENAME](std::string_view const a_extension) {
+    return FILENAME.size() >= a_extension.size() &&
+           FILENAME.substr(FILENAME.size() - a_extension.size()) == a_extension;
+  };
+
+  if (has_extension(EXTENSION)) return Format::eBinary;
+  if (has_extension(CBOR_EXTENSION)) return Format::eCbor;
+  if (has_extension(MSGPACK_EXTENSION)) return Format::eMsgPack;
+  return a_default;
+}
+
+PackageFile::Format PackageFile::detect(std::string const &a_filename)
+{
+  std::ifstream file{ a_filename, std::ios::binary };
+  if (!file.is_open()) return Format::eJson;
+
+  uint32_t magic{};
+  file.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+  if (file.gcount() == sizeof(magic) && magic == MAGIC) return Format::eBinary;
+  if (file.gcount() == 0) return Format::eJson;
+
+  // CBOR maps are major type 5 (0xa0-0xbf), MessagePack ones fixmap, map 16 or map 32.
+  auto const FIRST = static_cast<uint8_t>(magic & 0xFF);
+  if (FIRST >= 0xA0 && FIRST <= 0xBF) return Format::eCbor;
+  if ((FIRST >= 0x80 && FIRST <= 0x8F) || FIRST == 0xDE || FIRST == 0xDF) return Format::eMsgPack;
+  return Format::eJson;
+}
+
+bool PackageFile::read(std::string const &a_filename, Json &a_json)
+{
+  auto const FORMAT = detect(a_filename);
+
+  if (FORMAT == Format::eBinary) {
+    PackageFile file{};
+    if (!file.open(a_filename)) return false;
+    a_json = file.toJson();
+    return true;
+  }
+
+  std::ifstream file{ a_filename, std::ios::binary };
+  if (!file.is_open()) {
+    log::error("Can't open {}", a_filename);
+    return false;
+  }
+
+  if (FORMAT == Format::eJson) {
+    file >> a_json;
+    return true;
+  }
+
+  std::vector<uint8_t> const BUFFER{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+  a_json = FORMAT == Format::eCbor ? Json::from_cbor(BUFFER) : Json::from_msgpack(BUFFER);
+  return true;
+}
+
+bool PackageFile::readRoot(std::string const &a_filename, Json &a_json)
+{
+  auto const FORMAT = detect(a_filename);
+
+  if (FORMAT == Format::eBinary) {
+    PackageFile file{};
+    if (!file.open(a_filename)) return false;
+    a_json = file.root();
+    return true;
+  }
+
+  if (FORMAT != Format::eJson) {
+    if (!read(a_filename, a_json)) return false;
+    if (!a_json.is_object() || a_json.count("package") == 0) return true;
+    a_json["package"]["elements"] = Json::array();
+    a_json["package"]["connections"] = Json::array();
+    return true;
+  }
+
+  std::ifstream file{ a_filename, std::ios::binary };
+  if (!file.is_open()) {
+    log::error("Can't open {}", a_filename);
+    return false;
+  }
+
+  std::string const TEXT{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+  JsonSkipper skipper{ TEXT };
+  if (read_members(skipper, a_json, "package", { "elements", "connections" })) return true;
+
+  log::error("Can't parse {}", a_filename);
+  return false;
+}
+
+bool PackageFile::write(std::string const &a_filename, Json const &a_json, Format const a_format)
+{
+  std::ofstream file{ a_filename, std::ios::binary | std::ios::trunc };
+  if (!file.is_open()) {
+    log::error("Can't open {} for writing", a_filename);
+    return false;
+  }
+
+  auto write_buffer = [&file](std::vector<uint8_t> const &a_buffer) {
+    file.write(reinterpret_cast<char const *>(a_buffer.data()), static_cast<std::streamsize>(a_buffer.size()));
+  };
+
+  switch (a_format) {
+    case Format::eJson: file << a_json.dump(2); break;
+    case Format::eCbor: write_buffer(Json::to_cbor(a_json)); break;
+    case Format::eMsgPack: write_buffer(Json::to_msgpack(a_json)); break;
+    case Format::eBinary: write_buffer(encode(a_json)); break;
+  }
+
+  return file.good();
+}
+
+std::vector<uint8_t> PackageFile::encode(Json const &a_json)
+{
+  Writer writer{};
+
+  auto const PACKAGE_IT = a_json.is_object() ? a_json.find("package") : a_json.end();
+  bool const HAS_TABLES{ PACKAGE_IT != a_json.end() && PACKAGE_IT->is_object() && PACKAGE_IT->count("elements") &&
+                         PACKAGE_IT->count("connections") && PACKAGE_IT->at("elements").is_array() };
+
+  if (HAS_TABLES && writer.addConnections(PACKAGE_IT->at("connections"))) {
+    Json root = a_json;
+    root["package"].erase("elements");
+    root["package"].erase("connections");
+    writer.addElement(root);
+    for (auto const &ELEMENT : PACKAGE_IT->at("elements")) writer.addElement(ELEMENT);
+  } else
+    writer.addRaw(a_json);
+
+  return writer.finish();
+}
+
+bool PackageFile::convert(std::string const &a_from, std::string const &a_to)
+{
+  Json json{};
+  if (!read(a_from, json)) return false;
+
+  return write(a_to, json, formatFor(a_to));
+}
+
+bool PackageFile::open(std::string const &a_filename)
+{
+  close();
+
+#ifdef SPAGHETTI_HAS_MMAP
+  int const FD{ ::open(a_filename.c_str(), O_RDONLY) };
+  if (FD < 0) {
+    log::error("Can't open {}", a_filename);
+    return false;
+  }
+
+  struct stat info {};
+  if (::fstat(FD, &info) == 0 && info.st_size > 0) {
+    void *const DATA{ ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, FD, 0) };
+    if (DATA != MAP_FAILED) {
+      m_data = static_cast<uint8_t const *>(DATA);
+      m_size = static_cast<size_t>(info.st_size);
+      m_mapped = true;
+    }
+  }
+  ::close(FD);
+#else
+  std::ifstream file{ a_filename, std::ios::binary };
+  if (!file.is_open()) {
+    log::error("Can't open {}", a_filename);
+    return false;
+  }
+  m_buffer.assign(std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{});
+  if (!m_buffer.empty()) {
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+  }
+#endif
+
+  auto invalid = [&](char const *const a_reason) {
+    log::error("{} is not a valid package: {}", a_filename, a_reason);
+    close();
+    return false;
+  };
+
+  if (m_data == nullptr || m_size < sizeof(Header)) return invalid("too short");
+
+  auto const &HEADER = *reinterpret_cast<Header const *>(m_data);
+  if (HEADER.magic != MAGIC) return invalid("wrong magic");
+  if (HEADER.version != VERSION) return invalid("unsupported version");
+  if (HEADER.elementsCount == 0) return invalid("no root record");
+  if (!fits(HEADER.stringsOffset, HEADER.stringsCount, sizeof(StringRecord), m_size) ||
+      !fits(HEADER.elementsOffset, HEADER.elementsCount, sizeof(ElementRecord), m_size) ||
+      !fits(HEADER.socketsOffset, HEADER.socketsCount, sizeof(SocketRecord), m_size) ||
+      !fits(HEADER.connectionsOffset, HEADER.connectionsCount, sizeof(ConnectionRecord), m_size) ||
+      HEADER.dataOffset > m_size || HEADER.dataSize > m_size - HEADER.dataOffset)
+    return invalid("table out of bounds");
+
+  // Records are checked once here, accessors then index them directly.
+  auto const STRINGS = reinterpret_cast<StringRecord const *>(m_data + HEADER.stringsOffset);
+  for (uint32_t i = 0; i < HEADER.stringsCount; ++i)
+    if (STRINGS[i].offset > HEADER.dataSize || STRINGS[i].size > HEADER.dataSize - STRINGS[i].offset)
+      return invalid("string out of bounds");
+
+  auto const SOCKETS = reinterpret_cast<SocketRecord const *>(m_data + HEADER.socketsOffset);
+  for (uint32_t i = 0; i < HEADER.socketsCount; ++i)
+    if (SOCKETS[i].name >= HEADER.stringsCount || SOCKETS[i].type >= SOCKET_TYPES.size())
+      return invalid("broken socket record");
+
+  auto const ELEMENTS = reinterpret_cast<ElementRecord const *>(m_data + HEADER.elementsOffset);
+  for (uint32_t i = 0; i < HEADER.elementsCount; ++i) {
+    auto const &RECORD = ELEMENTS[i];
+    if (RECORD.extraOffset > HEADER.dataSize || RECORD.extraSize > HEADER.dataSize - RECORD.extraOffset)
+      return invalid("element data out of bounds");
+    if (RECORD.flags & ElementRecord::eRaw) continue;
+    if (RECORD.name >= HEADER.stringsCount || RECORD.type >= HEADER.stringsCount)
+      return invalid("broken element record");
+    if (RECORD.firstSocket > HEADER.socketsCount ||
+        size_t{ RECORD.inputs } + RECORD.outputs > HEADER.socketsCount - RECORD.firstSocket)
+      return invalid("element sockets out of bounds");
+  }
+
+  return true;
+}
+
+void PackageFile::close()
+{
+#ifdef SPAGHETTI_HAS_MMAP
+  if (m_mapped) ::munmap(const_cast<uint8_t *>(m_data), m_size);
+#endif
+  m_data = nullptr;
+  m_size = 0;
+  m_buffer.clear();
+  m_mapped = false;
+}
+
+PackageFile::Json PackageFile::root() const
+{
+  auto json = record(0);
+
+  auto const &HEADER = *reinterpret_cast<Header const *>(m_data);
+  auto const &ROOT = *reinterpret_cast<ElementRecord const *>(m_data + HEADER.elementsOffset);
+  if (ROOT.flags & ElementRecord::eRaw) return json;
+
+  auto &jsonPackage = json["package"];
+  jsonPackage["elements"] = Json::array();
+  jsonPackage["connections"] = Json::array();
+  return json;
+}
+
+size_t PackageFile::elementsCount() const
+{
+  if (!isOpen()) return 0;
+  return reinterpret_cast<Header const *>(m_data)->elementsCount - 1;
+}
+
+PackageFile::Json PackageFile::element(size_t const a_index) const
+{
+  assert(a_index < elementsCount());
+  return record(a_index + 1);
+}
+
+size_t PackageFile::connectionsCount() const
+{
+  if (!isOpen()) return 0;
+  return reinterpret_cast<Header const *>(m_data)->connectionsCount;
+}
+
+PackageFile::Connection PackageFile::connection(size_t const a_index) const
+{
+  assert(a_index < connectionsCount());
+
+  auto const &HEADER = *reinterpret_cast<Header const *>(m_data);
+  auto const &RECORD = reinterpret_cast<ConnectionRecord const *>(m_data + HEADER.connectionsOffset)[a_index];
+  return Connection{ RECORD.fromId, RECORD.toId, RECORD.fromSocket, RECORD.toSocket };
+}
+
+PackageFile::Json PackageFile::toJson() const
+{
+  if (!isOpen()) return Json{};
+
+  auto json = root();
+
+  auto const &HEADER = *reinterpret_cast<Header const *>(m_data);
+  auto const &ROOT = *reinterpret_cast<ElementRecord const *>(m_data + HEADER.elementsOffset);
+  if (ROOT.flags & ElementRecord::eRaw) return json;
+
+  auto &jsonElements = json["package"]["elements"];
+  size_t const ELEMENTS_COUNT{ elementsCount() };
+  for (size_t i = 0; i < ELEMENTS_COUNT; ++i) jsonElements.push_back(element(i));
+
+  auto &jsonConnections = json["package"]["connections"];
+  size_t const CONNECTIONS_COUNT{ connectionsCount() };
+  for (size_t i = 0; i < CONNECTIONS_COUNT; ++i) {
+    auto const CONNECTION = connection(i);
+    Json jsonConnection{};
+    jsonConnection["connect"]["id"] = CONNECTION.from_id;
+    jsonConnection["connect"]["socket"] = CONNECTION.from_socket;
+    jsonConnection["to"]["id"] = CONNECTION.to_id;
+    jsonConnection["to"]["socket"] = CONNECTION.to_socket;
+    jsonConnections.push_back(jsonConnection);
+  }
+
+  return json;
+}
+
+std::string_view PackageFile::string(uint32_t const a_index) const
+{
+  auto const &HEADER = *reinterpret_cast<Header const *>(m_data);
+  auto const &RECORD = reinterpret_cast<StringRecord const *>(m_data + HEADER.stringsOffset)[a_index];
+  auto const DATA = reinterpret_cast<char const *>(m_data + HEADER.dataOffset + RECORD.offset);
+  return std::string_view{ DATA, static_cast<size_t>(RECORD.size) };
+}
+
+PackageFile::Json PackageFile::record(size_t const a_index) const
+{
+  auto const &HEADER = *reinterpret_cast<Header const *>(m_data);
+  auto const &RECORD = reinterpret_cast<ElementRecord const *>(m_data + HEADER.elementsOffset)[a_index];
+
+  auto extra = blob(RECORD.extraOffset, RECORD.extraSize);
+  if (RECORD.flags & ElementRecord::eRaw) return extra;
+
+  auto const SOCKETS = reinterpret_cast<SocketRecord const *>(m_data + HEADER.socketsOffset);
+  auto const STRINGS = [this](uint32_t const a_string) { return std::string{ string(a_string) }; };
+  return assemble(RECORD, SOCKETS + RECORD.firstSocket, STRINGS, std::move(extra));
+}
+
+PackageFile::Json PackageFile::blob(uint64_t const a_offset, uint64_t const a_size) const
+{
+  if (a_size == 0) return Json::object();
+
+  auto const &HEADER = *reinterpret_cast<Header const *>(m_data);
+  auto const DATA = m_data + HEADER.dataOffset + a_offset;
+  return Json::from_cbor(DATA, DATA + a_size);
+}
+
+} // namespace spaghetti
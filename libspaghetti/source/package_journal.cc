@@ -0,0 +1,265 @@
+// MIT License
+//
+// Copyright (c) 2017-2018 Artur Wyszyński, aljen at hitomi dot pl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "spaghetti/package_journal.h"
+
+#include <array>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <set>
+
+#include "spaghetti/logger.h"
+#include "spaghetti/package_file.h"
+
+#include "filesystem.h"
+
+namespace spaghetti {
+
+namespace {
+
+constexpr uint32_t const VERSION{ 1 };
+
+using Link = std::array<size_t, 4>;
+
+// The package being replayed: elements by position and connections between them.
+struct Contents {
+  Element::Json header{};
+  std::map<size_t, Element::Json> elements{};
+  std::set<Link> connections{};
+};
+
+Link to_link(Element::Json const &a_json)
+{
+  return Link{ a_json[0].get<size_t>(), a_json[1].get<size_t>(), a_json[2].get<size_t>(), a_json[3].get<size_t>() };
+}
+
+Contents split(Element::Json &a_root)
+{
+  Contents contents{};
+
+  auto &jsonPackage = a_root["package"];
+  auto jsonElements = std::move(jsonPackage["elements"]);
+  auto const JSON_CONNECTIONS = std::move(jsonPackage["connections"]);
+  jsonPackage.erase("elements");
+  jsonPackage.erase("connections");
+  contents.header = std::move(a_root);
+
+  // Ids in the file needn't be positions, connections are translated along with the elements.
+  std::map<size_t, size_t> positions{ { 0, 0 } };
+  size_t position{};
+  for (auto &jsonElement : jsonElements) {
+    auto &id = jsonElement["element"]["id"];
+    positions[id.get<size_t>()] = ++position;
+    id = position;
+    contents.elements[position] = std::move(jsonElement);
+  }
+
+  for (auto const &CONNECTION : JSON_CONNECTIONS) {
+    auto const FROM = positions.find(CONNECTION["connect"]["id"].get<size_t>());
+    auto const TO = positions.find(CONNECTION["to"]["id"].get<size_t>());
+    if (FROM == positions.end() || TO == positions.end()) continue;
+
+    contents.connections.insert(Link{ FROM->second, CONNECTION["connect"]["socket"].get<size_t>(), TO->second,
+                                      CONNECTION["to"]["socket"].get<size_t>() });
+  }
+
+  return contents;
+}
+
+void apply(Contents &a_contents, Element::Json const &a_entry)
+{
+  if (a_entry.count("set")) {
+    auto const &ELEMENT = a_entry["set"];
+    a_contents.elements[ELEMENT["element"]["id"].get<size_t>()] = ELEMENT;
+  } else if (a_entry.count("remove")) {
+    auto const ID = a_entry["remove"].get<size_t>();
+    a_contents.elements.erase(ID);
+    for (auto it = a_contents.connections.begin(); it != a_contents.connections.end();) {
+      if ((*it)[0] == ID || (*it)[2] == ID)
+        it = a_contents.connections.erase(it);
+      else
+        ++it;
+    }
+  } else if (a_entry.count("connect")) {
+    a_contents.connections.insert(to_link(a_entry["connect"]));
+  } else if (a_entry.count("disconnect")) {
+    a_contents.connections.erase(to_link(a_entry["disconnect"]));
+  } else if (a_entry.count("header")) {
+    a_contents.header = a_entry["header"];
+  }
+}
+
+void join(Contents &a_contents, Element::Json &a_root)
+{
+  a_root = std::move(a_contents.header);
+
+  auto jsonElements = Element::Json::array();
+  for (auto &element : a_contents.elements) jsonElements.push_back(std::move(element.second));
+
+  auto jsonConnections = Element::Json::array();
+  for (auto const &LINK : a_contents.connections) {
+    Element::Json jsonConnection{};
+    jsonConnection["connect"]["id"] = LINK[0];
+    jsonConnection["connect"]["socket"] = LINK[1];
+    jsonConnection["to"]["id"] = LINK[2];
+    jsonConnection["to"]["socket"] = LINK[3];
+    jsonConnections.push_back(std::move(jsonConnection));
+  }
+
+  a_root["package"]["elements"] = std::move(jsonElements);
+  a_root["package"]["connections"] = std::move(jsonConnections);
+}
+
+} // namespace
+
+uint64_t PackageJournal::fingerprint(std::string const &a_base)
+{
+  std::ifstream file{ a_base, std::ios::binary };
+  if (!file.is_open()) return 0;
+
+  uint64_t hash{ 0xcbf29ce484222325 };
+  std::vector<char> buffer(1 << 16);
+  while (file) {
+    file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    auto const READ = static_cast<size_t>(file.gcount());
+    for (size_t i = 0; i < READ; ++i) hash = (hash ^ static_cast<uint8_t>(buffer[i])) * 0x100000001b3;
+  }
+
+  return hash;
+}
+
+bool PackageJournal::start(std::string const &a_base)
+{
+  auto const FILENAME = filenameFor(a_base);
+  auto const TEMP_FILENAME = FILENAME + ".tmp";
+
+  Json header{};
+  header["base"] = fingerprint(a_base);
+  header["version"] = VERSION;
+
+  std::ofstream file{ TEMP_FILENAME, std::ios::binary | std::ios::trunc };
+  if (!file.is_open()) {
+    log::error("Can't open {} for writing", TEMP_FILENAME);
+    return false;
+  }
+
+  file << header.dump() << '\n';
+  file.close();
+  if (file.fail()) {
+    log::error("Starting journal {} failed", FILENAME);
+    std::remove(TEMP_FILENAME.c_str());
+    return false;
+  }
+
+  try {
+    fs::rename(TEMP_FILENAME, FILENAME);
+  } catch (fs::filesystem_error const &a_error) {
+    log::error("Can't replace {}: {}", FILENAME, a_error.what());
+    return false;
+  }
+
+  return true;
+}
+
+bool PackageJournal::append(std::string const &a_base, std::vector<Json> const &a_entries)
+{
+  auto const FILENAME = filenameFor(a_base);
+
+  std::ofstream file{ FILENAME, std::ios::binary | std::ios::app };
+  if (!file.is_open()) {
+    log::error("Can't open {} for writing", FILENAME);
+    return false;
+  }
+
+  // One write per batch, a crash leaves at most its tail torn.
+  std::string batch{};
+  for (auto const &ENTRY : a_entries) batch += ENTRY.dump() + '\n';
+  Json commit{};
+  commit["commit"] = a_entries.size();
+  batch += commit.dump() + '\n';
+
+  file.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+  file.close();
+  if (file.fail()) {
+    log::error("Appending to journal {} failed", FILENAME);
+    return false;
+  }
+
+  return true;
+}
+
+size_t PackageJournal::size(std::string const &a_base)
+{
+  try {
+    return static_cast<size_t>(fs::file_size(filenameFor(a_base)));
+  } catch (fs::filesystem_error const &) {
+    return 0;
+  }
+}
+
+bool PackageJournal::replay(std::string const &a_base, Json &a_root)
+{
+  auto const FILENAME = filenameFor(a_base);
+
+  std::ifstream file{ FILENAME, std::ios::binary };
+  if (!file.is_open()) return false;
+
+  std::string line{};
+  if (!std::getline(file, line)) return false;
+
+  auto const HEADER = Json::parse(line, nullptr, false);
+  if (HEADER.is_discarded() || !HEADER.is_object() || HEADER.value("version", uint32_t{}) != VERSION ||
+      HEADER.value("base", uint64_t{}) != fingerprint(a_base)) {
+    log::warn("Ignoring journal {}, it doesn't belong to {}", FILENAME, a_base);
+    return false;
+  }
+
+  if (!PackageFile::read(a_base, a_root)) return false;
+
+  auto contents = split(a_root);
+
+  std::vector<Json> batch{};
+  size_t saves{};
+  while (std::getline(file, line)) {
+    auto entry = Json::parse(line, nullptr, false);
+    if (entry.is_discarded() || !entry.is_object()) break;
+
+    if (entry.count("commit") == 0) {
+      batch.push_back(std::move(entry));
+      continue;
+    }
+
+    for (auto const &ENTRY : batch) apply(contents, ENTRY);
+    batch.clear();
+    saves++;
+  }
+
+  if (!batch.empty()) log::warn("Dropped {} journal entries of an unfinished save", batch.size());
+  log::info("Replayed {} saves from {}", saves, FILENAME);
+
+  join(contents, a_root);
+  return true;
+}
+
+} // namespace spaghetti
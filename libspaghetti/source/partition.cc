@@ -0,0 +1,553 @@
+// MIT License
+//
+// Copyright (c) 2017-2018 Artur Wyszyński, aljen at hitomi dot pl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "spaghetti/partition.h"
+
+// clang-format off
+#if !defined(_WIN64) && !defined(_WIN32)
+# include <arpa/inet.h>
+# include <netdb.h>
+# include <netinet/in.h>
+# include <netinet/tcp.h>
+# include <sys/socket.h>
+# include <sys/un.h>
+# include <unistd.h>
+# define SPAGHETTI_HAS_PARTITION 1
+#endif
+// clang-format on
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+#include "spaghetti/logger.h"
+#include "spaghetti/package.h"
+
+namespace spaghetti {
+
+namespace {
+
+uint32_t const HANDSHAKE_MAGIC{ 0x48475053 }; // "SPGH"
+uint32_t const FRAME_MAGIC{ 0x46475053 };     // "SPGF"
+size_t const FRAME_HEADER_SIZE{ sizeof(uint32_t) * 2 + sizeof(uint64_t) };
+size_t const FRAME_VALUE_SIZE{ 8 };
+// Routes are int16_t, a relayed list holds the outputs of all the other parts.
+size_t const MAX_SOCKETS{ static_cast<size_t>(std::numeric_limits<int16_t>::max()) };
+
+template<typename T>
+void write(std::vector<uint8_t> &a_buffer, T const a_value)
+{
+  auto const OFFSET = a_buffer.size();
+  a_buffer.resize(OFFSET + sizeof(T));
+  std::memcpy(a_buffer.data() + OFFSET, &a_value, sizeof(T));
+}
+
+template<typename T>
+T read(uint8_t const *const a_data)
+{
+  T value{};
+  std::memcpy(&value, a_data, sizeof(T));
+  return value;
+}
+
+// Values take FRAME_VALUE_SIZE bytes: the variant index followed by the value widened to 32 bits.
+void write_value(std::vector<uint8_t> &a_buffer, Element::Value const &a_value)
+{
+  write(a_buffer, static_cast<uint32_t>(a_value.index()));
+  switch (a_value.index()) {
+    case 0: write(a_buffer, static_cast<int32_t>(std::get<bool>(a_value))); break;
+    case 1: write(a_buffer, std::get<int32_t>(a_value)); break;
+    case 2: write(a_buffer, std::get<float>(a_value)); break;
+  }
+}
+
+Element::Value read_value(uint8_t const *const a_data)
+{
+  Element::Value value{};
+  switch (read<uint32_t>(a_data)) {
+    case 0: value = read<int32_t>(a_data + sizeof(uint32_t)) != 0; break;
+    case 1: value = read<int32_t>(a_data + sizeof(uint32_t)); break;
+    case 2: value = read<float>(a_data + sizeof(uint32_t)); break;
+  }
+  return value;
+}
+
+template<typename IOSockets>
+Partition::Sockets sockets_of(IOSockets const &a_sockets)
+{
+  Partition::Sockets sockets{};
+  for (auto const &SOCKET : a_sockets) sockets.push_back(Partition::Socket{ SOCKET.name, SOCKET.type });
+  return sockets;
+}
+
+#ifdef SPAGHETTI_HAS_PARTITION
+struct Address {
+  sockaddr_storage storage{};
+  socklen_t length{};
+  bool isUnix{};
+  std::string path{};
+};
+
+bool parse_address(std::string const &a_address, Address &a_result)
+{
+  if (a_address.compare(0, 5, "unix:") == 0) {
+    auto &unixAddress = reinterpret_cast<sockaddr_un &>(a_result.storage);
+    a_result.path = a_address.substr(5);
+    if (a_result.path.empty() || a_result.path.size() >= sizeof(unixAddress.sun_path)) return false;
+    unixAddress.sun_family = AF_UNIX;
+    std::strncpy(unixAddress.sun_path, a_result.path.c_str(), sizeof(unixAddress.sun_path) - 1);
+    a_result.length = sizeof(sockaddr_un);
+    a_result.isUnix = true;
+    return true;
+  }
+
+  if (a_address.compare(0, 4, "tcp:") != 0) return false;
+
+  auto const HOST_PORT = a_address.substr(4);
+  auto const COLON = HOST_PORT.rfind(':');
+  auto const HOST = COLON == std::string::npos ? std::string{ "127.0.0.1" } : HOST_PORT.substr(0, COLON);
+  auto const PORT = COLON == std::string::npos ? HOST_PORT : HOST_PORT.substr(COLON + 1);
+
+  addrinfo hints{};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo *info{};
+  if (getaddrinfo(HOST.c_str(), PORT.c_str(), &hints, &info) != 0 || info == nullptr) return false;
+  std::memcpy(&a_result.storage, info->ai_addr, info->ai_addrlen);
+  a_result.length = static_cast<socklen_t>(info->ai_addrlen);
+  freeaddrinfo(info);
+  return true;
+}
+
+bool send_all(int const a_socket, uint8_t const *a_data, size_t a_size)
+{
+#ifdef MSG_NOSIGNAL
+  int const FLAGS{ MSG_NOSIGNAL };
+#else
+  int const FLAGS{};
+#endif
+  while (a_size > 0) {
+    auto const SENT = ::send(a_socket, a_data, a_size, FLAGS);
+    if (SENT < 0 && errno == EINTR) continue;
+    if (SENT <= 0) return false;
+    a_data += SENT;
+    a_size -= static_cast<size_t>(SENT);
+  }
+  return true;
+}
+
+bool receive_all(int const a_socket, uint8_t *a_data, size_t a_size)
+{
+  while (a_size > 0) {
+    auto const RECEIVED = ::recv(a_socket, a_data, a_size, 0);
+    if (RECEIVED < 0 && errno == EINTR) continue;
+    if (RECEIVED <= 0) return false;
+    a_data += RECEIVED;
+    a_size -= static_cast<size_t>(RECEIVED);
+  }
+  return true;
+}
+
+// Sockets go as their value type followed by the length and bytes of their name.
+void write_sockets(std::vector<uint8_t> &a_buffer, Partition::Sockets const &a_sockets)
+{
+  write(a_buffer, static_cast<uint32_t>(a_sockets.size()));
+  for (auto const &SOCKET : a_sockets) {
+    write(a_buffer, static_cast<uint8_t>(SOCKET.type));
+    write(a_buffer, static_cast<uint16_t>(SOCKET.name.size()));
+    a_buffer.insert(std::end(a_buffer), std::begin(SOCKET.name), std::end(SOCKET.name));
+  }
+}
+
+bool receive_sockets(int const a_socket, Partition::Sockets &a_sockets)
+{
+  uint8_t count[sizeof(uint32_t)]{};
+  if (!receive_all(a_socket, count, sizeof(count))) return false;
+
+  auto const COUNT = read<uint32_t>(count);
+  if (COUNT > MAX_SOCKETS) {
+    log::error("[partition]: Peer announced {} sockets, at most {} are supported", COUNT, MAX_SOCKETS);
+    return false;
+  }
+
+  a_sockets.resize(COUNT);
+  for (auto &socket : a_sockets) {
+    uint8_t header[sizeof(uint8_t) + sizeof(uint16_t)]{};
+    if (!receive_all(a_socket, header, sizeof(header))) return false;
+
+    auto const TYPE = read<uint8_t>(header);
+    if (TYPE > static_cast<uint8_t>(ValueType::eFloat)) {
+      log::error("[partition]: Peer announced a socket of unknown type {}", TYPE);
+      return false;
+    }
+    socket.type = static_cast<ValueType>(TYPE);
+
+    auto &name = socket.name;
+    name.resize(read<uint16_t>(header + sizeof(uint8_t)));
+    if (!name.empty() && !receive_all(a_socket, reinterpret_cast<uint8_t *>(&name[0]), name.size())) return false;
+  }
+  return true;
+}
+
+void set_no_delay(int const a_socket, Address const &a_address)
+{
+  if (a_address.isUnix) return;
+  int const ENABLE{ 1 };
+  setsockopt(a_socket, IPPROTO_TCP, TCP_NODELAY, &ENABLE, sizeof(ENABLE));
+}
+#endif
+
+} // namespace
+
+Partition::Partition(Package *const a_package)
+  : m_package{ a_package }
+{
+  assert(m_package && m_package->package() == nullptr && "Only root package can be partitioned");
+}
+
+Partition::~Partition()
+{
+  close();
+}
+
+bool Partition::listen(std::string const &a_address, size_t const a_peers)
+{
+#ifdef SPAGHETTI_HAS_PARTITION
+  Address address{};
+  if (!parse_address(a_address, address)) {
+    log::error("[partition]: Invalid address '{}'", a_address);
+    return false;
+  }
+
+  int const LISTENER{ ::socket(address.storage.ss_family, SOCK_STREAM, 0) };
+  if (LISTENER < 0) {
+    log::error("[partition]: socket error: {}", std::strerror(errno));
+    return false;
+  }
+
+  int const ENABLE{ 1 };
+  setsockopt(LISTENER, SOL_SOCKET, SO_REUSEADDR, &ENABLE, sizeof(ENABLE));
+  if (address.isUnix) ::unlink(address.path.c_str());
+
+  if (::bind(LISTENER, reinterpret_cast<sockaddr *>(&address.storage), address.length) != 0 ||
+      ::listen(LISTENER, static_cast<int>(a_peers)) != 0) {
+    log::error("[partition]: Can't listen on '{}': {}", a_address, std::strerror(errno));
+    ::close(LISTENER);
+    return false;
+  }
+
+  log::info("[partition]: Waiting for {} peer(s) on '{}'", a_peers, a_address);
+
+  bool success{ true };
+  for (size_t i = 0; i < a_peers && success; ++i) {
+    int const SOCKET{ ::accept(LISTENER, nullptr, nullptr) };
+    if (SOCKET < 0) {
+      log::error("[partition]: accept error: {}", std::strerror(errno));
+      success = false;
+      break;
+    }
+    set_no_delay(SOCKET, address);
+    m_peers.push_back(Peer{ SOCKET, {}, {}, {}, {} });
+  }
+
+  ::close(LISTENER);
+  if (address.isUnix) ::unlink(address.path.c_str());
+
+  if (!success) return false;
+
+  // Connected parts introduce themselves first, each one is answered with the outputs of this part followed by
+  // those of all the other parts, in the order their values are relayed.
+  for (auto &&peer : m_peers)
+    if (!receiveSockets(peer)) return false;
+
+  auto const OUTPUTS = sockets_of(m_package->outputs());
+  auto const INPUTS = sockets_of(m_package->inputs());
+  for (auto const &PEER : m_peers) {
+    Sockets outputs{ OUTPUTS };
+    for (auto const &OTHER : m_peers)
+      if (&OTHER != &PEER) outputs.insert(std::end(outputs), std::begin(OTHER.outputs), std::end(OTHER.outputs));
+    if (!sendSockets(PEER, outputs, INPUTS)) return false;
+  }
+
+  checkRoutes();
+  m_relay = true;
+
+  return true;
+#else
+  (void)a_address;
+  (void)a_peers;
+  log::error("[partition]: Partitioned simulation isn't supported on this platform");
+  return false;
+#endif
+}
+
+bool Partition::connect(std::string const &a_address)
+{
+#ifdef SPAGHETTI_HAS_PARTITION
+  Address address{};
+  if (!parse_address(a_address, address)) {
+    log::error("[partition]: Invalid address '{}'", a_address);
+    return false;
+  }
+
+  // The listening part may not be up yet, keep retrying for a few seconds.
+  size_t const MAX_ATTEMPTS{ 100 };
+  for (size_t attempt = 0; attempt < MAX_ATTEMPTS; ++attempt) {
+    int const SOCKET{ ::socket(address.storage.ss_family, SOCK_STREAM, 0) };
+    if (SOCKET < 0) {
+      log::error("[partition]: socket error: {}", std::strerror(errno));
+      return false;
+    }
+
+    if (::connect(SOCKET, reinterpret_cast<sockaddr *>(&address.storage), address.length) == 0) {
+      set_no_delay(SOCKET, address);
+      m_peers.push_back(Peer{ SOCKET, {}, {}, {}, {} });
+      auto &peer = m_peers.back();
+      return sendSockets(peer, sockets_of(m_package->outputs()), sockets_of(m_package->inputs())) &&
+             receiveSockets(peer);
+    }
+
+    ::close(SOCKET);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+
+  log::error("[partition]: Can't connect to '{}': {}", a_address, std::strerror(errno));
+  return false;
+#else
+  (void)a_address;
+  log::error("[partition]: Partitioned simulation isn't supported on this platform");
+  return false;
+#endif
+}
+
+void Partition::close()
+{
+#ifdef SPAGHETTI_HAS_PARTITION
+  for (auto &&peer : m_peers) ::close(peer.socket);
+#endif
+  m_peers.clear();
+  m_relay = false;
+}
+
+bool Partition::sendSockets(Peer const &a_peer, Sockets const &a_outputs, Sockets const &a_inputs)
+{
+#ifdef SPAGHETTI_HAS_PARTITION
+  m_buffer.clear();
+  write(m_buffer, HANDSHAKE_MAGIC);
+  write_sockets(m_buffer, a_outputs);
+  write_sockets(m_buffer, a_inputs);
+  return send_all(a_peer.socket, m_buffer.data(), m_buffer.size());
+#else
+  (void)a_peer;
+  (void)a_outputs;
+  (void)a_inputs;
+  return false;
+#endif
+}
+
+bool Partition::receiveSockets(Peer &a_peer)
+{
+#ifdef SPAGHETTI_HAS_PARTITION
+  uint8_t magic[sizeof(uint32_t)]{};
+  if (!receive_all(a_peer.socket, magic, sizeof(magic))) return false;
+  if (read<uint32_t>(magic) != HANDSHAKE_MAGIC) {
+    log::error("[partition]: Peer didn't send a valid handshake");
+    return false;
+  }
+
+  if (!receive_sockets(a_peer.socket, a_peer.outputs) || !receive_sockets(a_peer.socket, a_peer.inputs)) return false;
+
+  // A value of another type would be read as the wrong alternative by the elements behind the input.
+  auto const &INPUTS = m_package->inputs();
+  size_t const COUNT{ a_peer.outputs.size() };
+  a_peer.routes.assign(COUNT, -1);
+  for (size_t i = 0; i < COUNT; ++i) {
+    auto const &OUTPUT = a_peer.outputs[i];
+    for (size_t input = 0; input < INPUTS.size(); ++input) {
+      if (INPUTS[input].name != OUTPUT.name) continue;
+      if (INPUTS[input].type != OUTPUT.type) {
+        log::error("[partition]: Remote output '{}' doesn't match the type of input {}, ignoring it", OUTPUT.name,
+                   input);
+        break;
+      }
+      a_peer.routes[i] = static_cast<int16_t>(input);
+      log::debug("[partition]: Remote output '{}' feeds input {}", OUTPUT.name, input);
+      break;
+    }
+  }
+
+  return true;
+#else
+  (void)a_peer;
+  return false;
+#endif
+}
+
+void Partition::checkRoutes() const
+{
+  // Only the listening part knows every part's sockets. Part 0 is this one, the others are numbered as they
+  // connected.
+  std::vector<Sockets const *> outputs{};
+  std::vector<Sockets const *> inputs{};
+  Sockets const OUTPUTS{ sockets_of(m_package->outputs()) };
+  Sockets const INPUTS{ sockets_of(m_package->inputs()) };
+  outputs.push_back(&OUTPUTS);
+  inputs.push_back(&INPUTS);
+  for (auto const &PEER : m_peers) {
+    outputs.push_back(&PEER.outputs);
+    inputs.push_back(&PEER.inputs);
+  }
+
+  size_t const PARTS_COUNT{ outputs.size() };
+  for (size_t part = 0; part < PARTS_COUNT; ++part) {
+    for (auto const &OUTPUT : *outputs[part]) {
+      auto const MATCHES = [&OUTPUT](Socket const &a_input) {
+        return a_input.name == OUTPUT.name && a_input.type == OUTPUT.type;
+      };
+      bool fed{};
+      for (size_t other = 0; other < PARTS_COUNT && !fed; ++other)
+        fed = other != part && std::any_of(std::begin(*inputs[other]), std::end(*inputs[other]), MATCHES);
+      if (!fed) log::error("[partition]: Output '{}' of part {} matches no input of another part", OUTPUT.name, part);
+    }
+  }
+}
+
+bool Partition::sendFrame(Peer const &a_peer, std::vector<uint8_t> const &a_values, size_t const a_count)
+{
+#ifdef SPAGHETTI_HAS_PARTITION
+  m_buffer.clear();
+  write(m_buffer, FRAME_MAGIC);
+  write(m_buffer, static_cast<uint32_t>(a_count));
+  write(m_buffer, m_tick);
+  m_buffer.insert(std::end(m_buffer), std::begin(a_values), std::end(a_values));
+
+  if (send_all(a_peer.socket, m_buffer.data(), m_buffer.size())) return true;
+
+  log::error("[partition]: Lost connection to peer while sending tick {}", m_tick);
+  return false;
+#else
+  (void)a_peer;
+  (void)a_values;
+  (void)a_count;
+  return false;
+#endif
+}
+
+bool Partition::receiveFrame(Peer &a_peer)
+{
+#ifdef SPAGHETTI_HAS_PARTITION
+  size_t const SIZE{ FRAME_HEADER_SIZE + a_peer.routes.size() * FRAME_VALUE_SIZE };
+  m_buffer.resize(SIZE);
+  if (!receive_all(a_peer.socket, m_buffer.data(), SIZE)) {
+    log::error("[partition]: Lost connection to peer while waiting for tick {}", m_tick);
+    return false;
+  }
+
+  auto const MAGIC = read<uint32_t>(m_buffer.data());
+  auto const COUNT = read<uint32_t>(m_buffer.data() + sizeof(uint32_t));
+  auto const TICK = read<uint64_t>(m_buffer.data() + sizeof(uint32_t) * 2);
+  if (MAGIC != FRAME_MAGIC || COUNT != a_peer.routes.size() || TICK != m_tick) {
+    log::error("[partition]: Peer is out of step (tick {}, expected {})", TICK, m_tick);
+    return false;
+  }
+
+  auto const VALUES = std::begin(m_buffer) + static_cast<std::ptrdiff_t>(FRAME_HEADER_SIZE);
+  a_peer.values.assign(VALUES, std::end(m_buffer));
+
+  auto &inputs = m_package->inputs();
+  uint8_t const *data{ a_peer.values.data() };
+  for (auto const ROUTE : a_peer.routes) {
+    // Types were checked by the handshake, a socket changing its type afterwards is dropped rather than let through.
+    if (ROUTE >= 0 && static_cast<size_t>(ROUTE) < inputs.size()) {
+      auto &input = inputs[static_cast<size_t>(ROUTE)];
+      if (read<uint32_t>(data) == static_cast<uint32_t>(input.type)) input.value = read_value(data);
+    }
+    data += FRAME_VALUE_SIZE;
+  }
+
+  return true;
+#else
+  (void)a_peer;
+  return false;
+#endif
+}
+
+bool Partition::exchange()
+{
+  auto const &OUTPUTS = m_package->outputs();
+  size_t const COUNT{ OUTPUTS.size() };
+
+  m_values.clear();
+  for (auto const &OUTPUT : OUTPUTS) write_value(m_values, OUTPUT.value);
+
+  if (!m_relay) {
+    for (auto const &PEER : m_peers)
+      if (!sendFrame(PEER, m_values, COUNT)) return false;
+    for (auto &&peer : m_peers)
+      if (!receiveFrame(peer)) return false;
+    return true;
+  }
+
+  // The listening part needs every frame of this tick before it can relay them.
+  for (auto &&peer : m_peers)
+    if (!receiveFrame(peer)) return false;
+
+  std::vector<uint8_t> relayed{};
+  for (auto const &PEER : m_peers) {
+    relayed = m_values;
+    size_t count{ COUNT };
+    for (auto const &OTHER : m_peers) {
+      if (&OTHER == &PEER) continue;
+      relayed.insert(std::end(relayed), std::begin(OTHER.values), std::end(OTHER.values));
+      count += OTHER.outputs.size();
+    }
+    if (!sendFrame(PEER, relayed, count)) return false;
+  }
+
+  return true;
+}
+
+bool Partition::step(duration_t const &a_delta)
+{
+  if (!m_peers.empty() && !exchange()) return false;
+
+  m_package->update(a_delta);
+  m_package->calculate();
+  ++m_tick;
+
+  return true;
+}
+
+bool Partition::runFor(duration_t const &a_time, duration_t const &a_step)
+{
+  duration_t elapsed{};
+  while (elapsed < a_time) {
+    if (!step(a_step)) return false;
+    elapsed += a_step;
+  }
+  return true;
+}
+
+} // namespace spaghetti
@@ -32,6 +32,11 @@
 // clang-format on
 
 #include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
 #include "filesystem.h"
@@ -40,6 +45,9 @@
 #include <spaghetti/elements/all.h>
 #include "nodes/all.h"
 #include <spaghetti/logger.h>
+#include <spaghetti/package.h>
+#include <spaghetti/package_bundle.h>
+#include <spaghetti/package_journal.h>
 #include <spaghetti/version.h>
 
 inline void init_resources()
@@ -69,14 +77,31 @@ namespace spaghetti {
 struct Registry::PIMPL {
   using Plugins = std::vector<std::shared_ptr<SharedLibrary>>;
   using MetaInfos = std::vector<MetaInfo>;
+#if PACKAGE_MAP == PACKAGE_SPP_MAP
+  using MetaInfosIndex = spp::sparse_hash_map<string::hash_t, size_t>;
+#elif PACKAGE_MAP == PACKAGE_STD_UNORDERED_MAP
+  using MetaInfosIndex = std::unordered_map<string::hash_t, size_t>;
+#endif
+  using PackagesIndex = std::unordered_map<std::string, std::string>;
+  using ModificationTime = decltype(fs::last_write_time(fs::path{}));
+  struct Prototype {
+    std::unique_ptr<Package> package{};
+    ModificationTime modified{};
+  };
+  using Prototypes = std::unordered_map<std::string, Prototype>;
   MetaInfos metaInfos{};
+  MetaInfosIndex metaInfosIndex{};
   Plugins plugins{};
   Packages packages{};
+  PackagesIndex packagesIndex{};
+  Prototypes prototypes{};
   fs::path app_path{};
   fs::path system_plugins_path{};
   fs::path user_plugins_path{};
   fs::path system_packages_path{};
   fs::path user_packages_path{};
+  fs::path plan_cache_path{};
+  uint64_t elements_signature{};
 };
 
 Registry &Registry::get()
@@ -291,11 +316,105 @@ std::vector<fs::path> scan_for_dirs(fs::path const &a_path)
   return ret;
 }
 
+namespace {
+
+// Package headers read by earlier runs, an entry holds while its file keeps the same size and modification time.
+constexpr char const *const PACKAGES_CACHE_FILENAME{ "packages.cache" };
+constexpr uint32_t const PACKAGES_CACHE_VERSION{ 1 };
+
+struct CachedPackage {
+  int64_t modified{};
+  uint64_t size{};
+  Registry::PackageInfo info{};
+};
+using PackagesCache = std::unordered_map<std::string, CachedPackage>;
+
+template<typename Time>
+int64_t time_stamp(Time const &a_time)
+{
+  if constexpr (std::is_arithmetic_v<Time>)
+    return static_cast<int64_t>(a_time);
+  else
+    return static_cast<int64_t>(a_time.time_since_epoch().count());
+}
+
+bool stamp_package(std::string const &a_filename, CachedPackage &a_package)
+{
+  try {
+    fs::path const PATH{ a_filename };
+    a_package.modified = time_stamp(fs::last_write_time(PATH));
+    a_package.size = static_cast<uint64_t>(fs::file_size(PATH));
+    return true;
+  } catch (fs::filesystem_error const &) {
+    return false;
+  }
+}
+
+PackagesCache read_packages_cache(fs::path const &a_path)
+{
+  PackagesCache cache{};
+
+  std::ifstream file{ a_path.string() };
+  if (!file.is_open()) return cache;
+
+  auto const JSON = Element::Json::parse(file, nullptr, false);
+  if (JSON.is_discarded() || !JSON.is_object() || JSON.value("version", uint32_t{}) != PACKAGES_CACHE_VERSION)
+    return cache;
+
+  auto const &PACKAGES = JSON["packages"];
+  for (auto it = PACKAGES.begin(); it != PACKAGES.end(); ++it) {
+    auto const &ENTRY = it.value();
+    auto &package = cache[it.key()];
+    package.modified = ENTRY.value("modified", int64_t{});
+    package.size = ENTRY.value("size", uint64_t{});
+    package.info.filename = it.key();
+    package.info.path = ENTRY.value("path", std::string{});
+    package.info.icon = ENTRY.value("icon", std::string{});
+  }
+
+  return cache;
+}
+
+void write_packages_cache(fs::path const &a_path, PackagesCache const &a_cache)
+{
+  Element::Json json{};
+  json["version"] = PACKAGES_CACHE_VERSION;
+  auto &jsonPackages = json["packages"];
+  jsonPackages = Element::Json::object();
+  for (auto const &PACKAGE : a_cache) {
+    auto &entry = jsonPackages[PACKAGE.first];
+    entry["modified"] = PACKAGE.second.modified;
+    entry["size"] = PACKAGE.second.size;
+    entry["path"] = PACKAGE.second.info.path;
+    entry["icon"] = PACKAGE.second.info.icon;
+  }
+
+  auto const FILENAME = a_path.string();
+  auto const TEMP_FILENAME = FILENAME + ".tmp";
+  std::ofstream file{ TEMP_FILENAME, std::ios::trunc };
+  file << json.dump();
+  file.close();
+  if (file.fail()) {
+    log::error("Can't write packages cache {}", FILENAME);
+    std::remove(TEMP_FILENAME.c_str());
+    return;
+  }
+
+  try {
+    fs::rename(TEMP_FILENAME, FILENAME);
+  } catch (fs::filesystem_error const &a_error) {
+    log::error("Can't replace {}: {}", FILENAME, a_error.what());
+  }
+}
+
+} // namespace
+
 void Registry::loadPackages()
 {
-  Packages packages{};
+  std::vector<std::string> filenames{};
+  std::vector<std::string> bundles{};
 
-  auto loadFrom = [&packages](fs::path const &a_path) {
+  auto scanFrom = [&filenames, &bundles](fs::path const &a_path) {
     log::warn("Loading packages from {}", a_path.string());
     auto directories = scan_for_dirs(a_path);
     directories.push_back(a_path);
@@ -303,20 +422,105 @@ void Registry::loadPackages()
     for (auto const &DIRECTORY : directories) {
       for (auto const &ENTRY : fs::directory_iterator(DIRECTORY)) {
         if (fs::is_directory(ENTRY)) continue;
-        auto const FILENAME = ENTRY.path().string();
-        log::warn("Loading package '{}'", FILENAME);
-        packages[FILENAME] = Package::getInfoFor(FILENAME);
+        // Journals and unfinished saves sit next to the packages they belong to.
+        auto const EXTENSION = ENTRY.path().extension().string();
+        if (EXTENSION == PackageJournal::EXTENSION || EXTENSION == ".tmp") continue;
+        if (EXTENSION == PackageBundle::EXTENSION)
+          bundles.push_back(ENTRY.path().string());
+        else
+          filenames.push_back(ENTRY.path().string());
       }
     }
   };
 
-  loadFrom(m_pimpl->system_packages_path);
-  loadFrom(m_pimpl->user_packages_path);
+  scanFrom(m_pimpl->system_packages_path);
+  scanFrom(m_pimpl->user_packages_path);
+
+  auto const CACHE_PATH = m_pimpl->user_packages_path.parent_path() / PACKAGES_CACHE_FILENAME;
+  auto const CACHE = read_packages_cache(CACHE_PATH);
+
+  size_t const COUNT{ filenames.size() };
+  std::vector<CachedPackage> scanned(COUNT);
+  std::vector<uint8_t> cacheable(COUNT);
+  std::vector<size_t> missing{};
+  for (size_t i = 0; i < COUNT; ++i) {
+    auto const &FILENAME = filenames[i];
+    auto &package = scanned[i];
+
+    // A journal may change the header without touching the package file, those are read every time.
+    cacheable[i] = stamp_package(FILENAME, package) && !fs::exists(PackageJournal::filenameFor(FILENAME));
+
+    auto const CACHED = CACHE.find(FILENAME);
+    if (cacheable[i] && CACHED != CACHE.end() && CACHED->second.modified == package.modified &&
+        CACHED->second.size == package.size)
+      package.info = CACHED->second.info;
+    else
+      missing.push_back(i);
+  }
+
+  // Packages missing from the cache are read in parallel, each one only fills its own slot.
+  std::atomic_size_t next{};
+  auto const READ = [&] {
+    for (size_t i{}; (i = next++) < missing.size();) {
+      auto const INDEX = missing[i];
+      log::warn("Loading package '{}'", filenames[INDEX]);
+      scanned[INDEX].info = Package::getInfoFor(filenames[INDEX]);
+    }
+  };
+
+  size_t const THREADS{ std::max<size_t>(std::thread::hardware_concurrency(), 1) };
+  std::vector<std::thread> workers{};
+  for (size_t i = 1; i < std::min(THREADS, missing.size()); ++i) workers.emplace_back(READ);
+  READ();
+  for (auto &worker : workers) worker.join();
 
-  log::warn("Loaded {} packages", packages.size());
+  Packages packages{};
+  PackagesCache cache{};
+  for (size_t i = 0; i < COUNT; ++i) {
+    auto const &PACKAGE = scanned[i];
+    if (PACKAGE.info.filename.empty()) {
+      log::warn("Skipping '{}', it isn't a package", filenames[i]);
+      continue;
+    }
+
+    packages[filenames[i]] = PACKAGE.info;
+    if (cacheable[i]) cache[filenames[i]] = PACKAGE;
+  }
+
+  if (!missing.empty() || cache.size() != CACHE.size()) write_packages_cache(CACHE_PATH, cache);
+
+  // Only the index of a bundle is read here, its packages are decoded when a prototype is first built.
+  for (auto const &BUNDLE_FILENAME : bundles) {
+    log::warn("Loading bundle '{}'", BUNDLE_FILENAME);
+    PackageBundle bundle{};
+    if (!bundle.open(BUNDLE_FILENAME)) continue;
+
+    size_t const ENTRIES_COUNT{ bundle.size() };
+    for (size_t i = 0; i < ENTRIES_COUNT; ++i) {
+      auto const ENTRY = bundle.entry(i);
+      PackageInfo info{};
+      info.path = std::string{ ENTRY.path };
+      info.icon = std::string{ ENTRY.icon };
+      info.filename = PackageBundle::memberFilename(BUNDLE_FILENAME, info.path);
+      packages[info.filename] = info;
+    }
+  }
+
+  log::warn("Loaded {} packages, {} of them from cache", packages.size(), COUNT - missing.size());
   for (auto const &PACKAGE : packages) log::warn("{} as '{}'", PACKAGE.first, PACKAGE.second.path);
 
+  // A package file takes precedence over a bundled package registered under the same path.
+  auto &packagesIndex = m_pimpl->packagesIndex;
+  packagesIndex.clear();
+  for (auto const &PACKAGE : packages) {
+    if (PackageBundle::isMember(PACKAGE.first))
+      packagesIndex.emplace(PACKAGE.second.path, PACKAGE.first);
+    else
+      packagesIndex[PACKAGE.second.path] = PACKAGE.first;
+  }
+
   m_pimpl->packages = packages;
+  m_pimpl->prototypes.clear();
 }
 
 Element *Registry::createElement(string::hash_t const a_hash)
@@ -326,6 +530,12 @@ Element *Registry::createElement(string::hash_t const a_hash)
   return META_INFO.cloneElement();
 }
 
+Element *Registry::createElementCopy(Element const &a_element)
+{
+  auto const &META_INFO = metaInfoFor(a_element.hash());
+  return META_INFO.copyElement ? META_INFO.copyElement(a_element) : nullptr;
+}
+
 Node *Registry::createNode(string::hash_t const a_hash)
 {
   auto const &META_INFO = metaInfoFor(a_hash);
@@ -348,15 +558,31 @@ std::string Registry::elementIcon(string::hash_t const a_hash)
 void Registry::addElement(MetaInfo &a_metaInfo)
 {
   auto &metaInfos = m_pimpl->metaInfos;
+  auto &metaInfosIndex = m_pimpl->metaInfosIndex;
+
+  auto const [IT, INSERTED] = metaInfosIndex.emplace(a_metaInfo.hash, metaInfos.size());
+  if (!INSERTED) {
+    auto const &EXISTING = metaInfos[IT->second];
+    if (EXISTING.type == a_metaInfo.type)
+      log::error("Element '{}' is already registered, ignoring", a_metaInfo.type);
+    else
+      log::error("Element '{}' hash collides with '{}', ignoring", a_metaInfo.type, EXISTING.type);
+    return;
+  }
+
+  m_pimpl->elements_signature += uint64_t{ a_metaInfo.hash } * 0x9E3779B97F4A7C15;
   metaInfos.push_back(std::move(a_metaInfo));
 }
 
 bool Registry::hasElement(string::hash_t const a_hash) const
 {
-  auto const &META_INFOS = m_pimpl->metaInfos;
-  auto const IT = std::find_if(std::begin(META_INFOS), std::end(META_INFOS),
-                               [a_hash](auto const &a_metaInfo) { return a_metaInfo.hash == a_hash; });
-  return IT != std::end(META_INFOS);
+  auto const &META_INFOS_INDEX = m_pimpl->metaInfosIndex;
+  return META_INFOS_INDEX.find(a_hash) != std::end(META_INFOS_INDEX);
+}
+
+uint64_t Registry::elementsSignature() const
+{
+  return m_pimpl->elements_signature;
 }
 
 size_t Registry::size() const
@@ -367,11 +593,10 @@ size_t Registry::size() const
 
 Registry::MetaInfo const &Registry::metaInfoFor(string::hash_t const a_hash) const
 {
-  auto &metaInfos = m_pimpl->metaInfos;
-  assert(hasElement(a_hash));
-  auto const IT = std::find_if(std::begin(metaInfos), std::end(metaInfos),
-                               [a_hash](auto const &a_metaInfo) { return a_metaInfo.hash == a_hash; });
-  return *IT;
+  auto const &META_INFOS_INDEX = m_pimpl->metaInfosIndex;
+  auto const IT = META_INFOS_INDEX.find(a_hash);
+  assert(IT != std::end(META_INFOS_INDEX));
+  return m_pimpl->metaInfos[IT->second];
 }
 
 Registry::MetaInfo const &Registry::metaInfoAt(size_t const a_index) const
@@ -385,6 +610,37 @@ Registry::Packages const &Registry::packages() const
   return m_pimpl->packages;
 }
 
+Package const *Registry::packagePrototype(std::string const &a_path)
+{
+  auto const &PACKAGES_INDEX = m_pimpl->packagesIndex;
+  auto const FILENAME_IT = PACKAGES_INDEX.find(a_path);
+  if (FILENAME_IT == std::end(PACKAGES_INDEX)) {
+    log::error("Can't find package registered as '{}'", a_path);
+    return nullptr;
+  }
+
+  auto const &FILENAME = FILENAME_IT->second;
+
+  // Bundled packages change along with their bundle.
+  std::string bundleFilename{};
+  std::string bundledPath{};
+  fs::path const PATH{ PackageBundle::split(FILENAME, bundleFilename, bundledPath) ? bundleFilename : FILENAME };
+  auto const MODIFIED = fs::exists(PATH) ? fs::last_write_time(PATH) : PIMPL::ModificationTime{};
+
+  // A package edited on disk since it was cached is loaded again, instances made before keep their copy.
+  auto &prototype = m_pimpl->prototypes[a_path];
+  if (prototype.package && prototype.modified == MODIFIED) return prototype.package.get();
+
+  log::debug("Building prototype of '{}' from '{}'", a_path, FILENAME);
+
+  auto package = std::make_unique<Package>();
+  package->open(FILENAME);
+
+  prototype.package = std::move(package);
+  prototype.modified = MODIFIED;
+  return prototype.package.get();
+}
+
 std::string Registry::appPath() const
 {
   return m_pimpl->app_path.string();
@@ -410,4 +666,14 @@ std::string Registry::userPackagesPath() const
   return m_pimpl->user_packages_path.string();
 }
 
+std::string Registry::planCachePath() const
+{
+  return m_pimpl->plan_cache_path.string();
+}
+
+void Registry::setPlanCachePath(std::string const &a_path)
+{
+  m_pimpl->plan_cache_path = a_path.empty() ? fs::path{} : fs::absolute(fs::path{ a_path });
+}
+
 } // namespace spaghetti
@@ -0,0 +1,84 @@
+// MIT License
+//
+// Copyright (c) 2017-2018 Artur Wyszyński, aljen at hitomi dot pl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "slab.h"
+
+#include <new>
+
+namespace spaghetti {
+
+Slab &Slab::get()
+{
+  // Never destroyed, elements owned by static objects may still be freed after exit() starts.
+  static Slab *const s_slab{ new Slab };
+  return *s_slab;
+}
+
+void *Slab::allocate(size_t const a_size)
+{
+  if (a_size == 0 || a_size > MAX_SIZE) return ::operator new(a_size);
+
+  size_t const CLASS_INDEX{ (a_size - 1) / GRANULARITY };
+  size_t const BLOCK_SIZE{ (CLASS_INDEX + 1) * GRANULARITY };
+
+  std::lock_guard<std::mutex> lock{ m_mutex };
+
+  auto &sizeClass = m_classes[CLASS_INDEX];
+
+  if (sizeClass.free) {
+    auto const block = sizeClass.free;
+    sizeClass.free = block->next;
+    return block;
+  }
+
+  if (sizeClass.current == sizeClass.end) {
+    auto const chunk = static_cast<char *>(::operator new(CHUNK_SIZE));
+    sizeClass.current = chunk;
+    sizeClass.end = chunk + (CHUNK_SIZE / BLOCK_SIZE) * BLOCK_SIZE;
+  }
+
+  auto const block = sizeClass.current;
+  sizeClass.current += BLOCK_SIZE;
+  return block;
+}
+
+void Slab::deallocate(void *const a_pointer, size_t const a_size) noexcept
+{
+  if (a_pointer == nullptr) return;
+
+  if (a_size == 0 || a_size > MAX_SIZE) {
+    ::operator delete(a_pointer);
+    return;
+  }
+
+  size_t const CLASS_INDEX{ (a_size - 1) / GRANULARITY };
+
+  std::lock_guard<std::mutex> lock{ m_mutex };
+
+  auto &sizeClass = m_classes[CLASS_INDEX];
+  auto const block = static_cast<FreeBlock *>(a_pointer);
+  block->next = sizeClass.free;
+  sizeClass.free = block;
+}
+
+} // namespace spaghetti
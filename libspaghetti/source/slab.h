@@ -0,0 +1,69 @@
+// MIT License
+//
+// Copyright (c) 2017-2018 Artur Wyszyński, aljen at hitomi dot pl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+#ifndef SPAGHETTI_SLAB_H
+#define SPAGHETTI_SLAB_H
+
+#include <array>
+#include <cstddef>
+#include <mutex>
+
+namespace spaghetti {
+
+// Size-classed slabs for element objects. Objects of one class are carved out of large chunks and freed ones
+// are reused first, so a package's elements end up densely packed instead of scattered over the heap.
+// Chunks are never returned, bigger objects go straight to the global allocator.
+class Slab final {
+ public:
+  static constexpr size_t const GRANULARITY{ 16 };
+  static constexpr size_t const MAX_SIZE{ 1024 };
+  static constexpr size_t const CHUNK_SIZE{ 64 * 1024 };
+
+  static Slab &get();
+
+  void *allocate(size_t const a_size);
+  void deallocate(void *const a_pointer, size_t const a_size) noexcept;
+
+ private:
+  Slab() = default;
+
+  struct FreeBlock {
+    FreeBlock *next{};
+  };
+
+  struct SizeClass {
+    FreeBlock *free{};
+    char *current{};
+    char *end{};
+  };
+
+  static constexpr size_t const CLASSES_COUNT{ MAX_SIZE / GRANULARITY };
+
+  std::mutex m_mutex{};
+  std::array<SizeClass, CLASSES_COUNT> m_classes{};
+};
+
+} // namespace spaghetti
+
+#endif // SPAGHETTI_SLAB_H
@@ -0,0 +1,251 @@
+// MIT License
+//
+// Copyright (c) 2017-2018 Artur Wyszyński, aljen at hitomi dot pl
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "spaghetti/timer_wheel.h"
+
+// clang-format off
+#ifdef _MSC_VER
+# include <intrin.h>
+#endif
+// clang-format on
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+inline size_t count_trailing_zeros(uint64_t const a_value)
+{
+#ifdef _MSC_VER
+  unsigned long index{};
+  _BitScanForward64(&index, a_value);
+  return index;
+#else
+  return static_cast<size_t>(__builtin_ctzll(a_value));
+#endif
+}
+
+inline uint64_t rotate_right(uint64_t const a_value, size_t const a_shift)
+{
+  return (a_value >> a_shift) | (a_value << ((64 - a_shift) & 63));
+}
+
+} // namespace
+
+namespace spaghetti {
+
+void TimerWheel::Timer::cancel()
+{
+  if (!m_wheel) return;
+
+  std::lock_guard<std::mutex> lock{ m_wheel->m_mutex };
+  m_wheel->remove(*this);
+}
+
+TimerWheel::duration_t TimerWheel::Timer::timeLeft() const
+{
+  if (!m_wheel) return duration_t::max();
+
+  return duration_t{ static_cast<double>(m_expiry) } - m_wheel->now();
+}
+
+TimerWheel::~TimerWheel()
+{
+  for (auto &level : m_levels) {
+    for (auto &slot : level.slots) {
+      while (slot) slot->cancel();
+    }
+  }
+}
+
+void TimerWheel::schedule(Timer &a_timer, duration_t const &a_timeout, Callback a_callback)
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+
+  if (a_timer.m_wheel) a_timer.m_wheel->remove(a_timer);
+
+  auto const EXPIRY = std::ceil((now() + a_timeout).count());
+  a_timer.m_expiry = std::max(m_now + 1, static_cast<uint64_t>(std::max(EXPIRY, 0.0)));
+  a_timer.m_callback = std::move(a_callback);
+  a_timer.m_wheel = this;
+  m_size++;
+
+  insert(a_timer);
+}
+
+void TimerWheel::advance(duration_t const &a_delta)
+{
+  if (a_delta <= duration_t::zero()) return;
+
+  auto const TOTAL = m_remainder + a_delta;
+  auto const TICKS = static_cast<uint64_t>(TOTAL.count());
+  uint64_t const TARGET{ m_now + TICKS };
+
+  // Callbacks see the time of the tick they expire at.
+  m_remainder = duration_t::zero();
+
+  while (m_now < TARGET) {
+    if (m_size == 0) {
+      m_now = TARGET;
+      break;
+    }
+
+    size_t lowest{};
+    while (m_levels[lowest].occupied == 0) ++lowest;
+
+    if (lowest > 0) {
+      uint64_t const SPAN{ uint64_t{ 1 } << (SLOT_BITS * lowest) };
+      uint64_t const LAST_IDLE_TICK{ m_now | (SPAN - 1) };
+      if (LAST_IDLE_TICK >= TARGET) {
+        m_now = TARGET;
+        break;
+      }
+      m_now = LAST_IDLE_TICK;
+    }
+
+    m_now++;
+
+    for (size_t level = 1; level < LEVELS; ++level) {
+      uint64_t const LEVEL_MASK{ (uint64_t{ 1 } << (SLOT_BITS * level)) - 1 };
+      if ((m_now & LEVEL_MASK) != 0) break;
+      cascade(level);
+    }
+
+    expire();
+  }
+
+  m_remainder = TOTAL - duration_t{ static_cast<double>(TICKS) };
+}
+
+void TimerWheel::reset(duration_t const &a_now)
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+
+  for (auto &level : m_levels) {
+    for (auto &slot : level.slots) {
+      while (slot) remove(*slot);
+    }
+  }
+
+  auto const TICKS = std::floor(std::max(a_now.count(), 0.0));
+  m_now = static_cast<uint64_t>(TICKS);
+  m_remainder = duration_t{ std::max(a_now.count(), 0.0) - TICKS };
+}
+
+TimerWheel::duration_t TimerWheel::timeToNextExpiry() const
+{
+  if (m_size == 0) return duration_t::max();
+
+  uint64_t next{ std::numeric_limits<uint64_t>::max() };
+
+  for (size_t level = 0; level < LEVELS; ++level) {
+    auto const OCCUPIED = m_levels[level].occupied;
+    if (OCCUPIED == 0) continue;
+
+    // For upper levels this is the start of the earliest occupied slot, which never comes after its expiries.
+    size_t const SHIFT{ SLOT_BITS * level };
+    uint64_t const CURRENT{ (m_now >> SHIFT) & SLOT_MASK };
+    uint64_t const DISTANCE{ count_trailing_zeros(rotate_right(OCCUPIED, (CURRENT + 1) & SLOT_MASK)) + 1 };
+    next = std::min(next, ((m_now >> SHIFT) + DISTANCE) << SHIFT);
+  }
+
+  return duration_t{ static_cast<double>(next - m_now) } - m_remainder;
+}
+
+void TimerWheel::insert(Timer &a_timer)
+{
+  uint64_t const RANGE{ uint64_t{ 1 } << (SLOT_BITS * LEVELS) };
+  uint64_t const DELTA{ a_timer.m_expiry - m_now };
+
+  size_t level{};
+  while (level + 1 < LEVELS && DELTA >= (uint64_t{ 1 } << (SLOT_BITS * (level + 1)))) ++level;
+
+  // Timers beyond the wheel's range wait in the farthest slot and get re-inserted when it cascades.
+  uint64_t const EXPIRY{ std::min(a_timer.m_expiry, m_now + RANGE - 1) };
+  auto const SLOT = static_cast<uint8_t>((EXPIRY >> (SLOT_BITS * level)) & SLOT_MASK);
+
+  auto &timers = m_levels[level];
+  a_timer.m_level = static_cast<uint8_t>(level);
+  a_timer.m_slot = SLOT;
+  a_timer.m_previous = nullptr;
+  a_timer.m_next = timers.slots[SLOT];
+  if (a_timer.m_next) a_timer.m_next->m_previous = &a_timer;
+  timers.slots[SLOT] = &a_timer;
+  timers.occupied |= uint64_t{ 1 } << SLOT;
+}
+
+void TimerWheel::remove(Timer &a_timer)
+{
+  unlink(a_timer);
+  m_size--;
+  a_timer.m_wheel = nullptr;
+  a_timer.m_callback = nullptr;
+}
+
+void TimerWheel::unlink(Timer &a_timer)
+{
+  auto &timers = m_levels[a_timer.m_level];
+  auto &slot = timers.slots[a_timer.m_slot];
+
+  if (a_timer.m_previous)
+    a_timer.m_previous->m_next = a_timer.m_next;
+  else
+    slot = a_timer.m_next;
+  if (a_timer.m_next) a_timer.m_next->m_previous = a_timer.m_previous;
+
+  if (slot == nullptr) timers.occupied &= ~(uint64_t{ 1 } << a_timer.m_slot);
+
+  a_timer.m_previous = nullptr;
+  a_timer.m_next = nullptr;
+}
+
+void TimerWheel::cascade(size_t const a_level)
+{
+  auto &slot = m_levels[a_level].slots[(m_now >> (SLOT_BITS * a_level)) & SLOT_MASK];
+  while (slot) {
+    auto &timer = *slot;
+    unlink(timer);
+    insert(timer);
+  }
+}
+
+void TimerWheel::expire()
+{
+  auto &slot = m_levels[0].slots[m_now & SLOT_MASK];
+  while (slot) {
+    auto &timer = *slot;
+    assert(timer.m_expiry == m_now);
+
+    unlink(timer);
+    timer.m_wheel = nullptr;
+    m_size--;
+
+    auto callback = std::move(timer.m_callback);
+    timer.m_callback = nullptr;
+    callback();
+  }
+}
+
+} // namespace spaghetti
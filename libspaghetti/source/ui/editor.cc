@@ -56,6 +56,7 @@
 #include <spaghetti/elements/logic/all.h>
 #include "spaghetti/node.h"
 #include "spaghetti/package.h"
+#include "spaghetti/package_file.h"
 #include "spaghetti/registry.h"
 #include "spaghetti/version.h"
 #include "ui/expander_widget.h"
@@ -365,6 +366,7 @@ int Editor::openPackageViews() const
 void Editor::newPackage()
 {
   auto const package = new Package;
+  package->setJournaling(true);
   openOrCreatePackageView(package);
 }
 
@@ -373,7 +375,7 @@ void Editor::openPackage()
   foreach (PackageView *temp, this->findChildren<PackageView *>())
     temp->setUpdatesEnabled(false);
 
-  QString const FILENAME{ QFileDialog::getOpenFileName(this, "Open .package", PACKAGES_DIR, "*.package") };
+  QString const FILENAME{ QFileDialog::getOpenFileName(this, "Open .package", PACKAGES_DIR, "*.package *.spkg *.cbor *.msgpack") };
 
   foreach (PackageView *temp, this->findChildren<PackageView *>())
     temp->setUpdatesEnabled(true);
@@ -394,6 +396,7 @@ void Editor::openPackageFile(QString const &a_filename)
   }
 
   auto const package = new Package;
+  package->setJournaling(true);
   package->open(a_filename.toStdString());
 
   openOrCreatePackageView(package);
@@ -437,13 +440,16 @@ void Editor::savePackageView(bool const a_saveAs)
     foreach (PackageView *temp, this->findChildren<PackageView *>())
       temp->setUpdatesEnabled(false);
 
-    QString filename{ QFileDialog::getSaveFileName(this, "Save .package", PACKAGES_DIR, "*.package") };
+    QString filename{ QFileDialog::getSaveFileName(this, "Save .package", PACKAGES_DIR, "*.package *.spkg *.cbor *.msgpack") };
 
     foreach (PackageView *temp, this->findChildren<PackageView *>())
       temp->setUpdatesEnabled(true);
 
     if (filename.isEmpty()) return;
-    if (!filename.endsWith(".package")) filename += ".package";
+    bool const KNOWN_EXTENSION{ filename.endsWith(".package") ||
+                                PackageFile::formatFor(filename.toStdString(), PackageFile::Format::eJson) !=
+                                  PackageFile::Format::eJson };
+    if (!KNOWN_EXTENSION) filename += ".package";
 
     packageView->setFilename(filename);
     QDir const packagesDir{ PACKAGES_DIR };
@@ -252,7 +252,9 @@ void PackageView::open()
 
 void PackageView::save()
 {
-  m_package->save(m_filename.toStdString());
+  // The previous save has to land before the next one replaces the file.
+  if (m_saving.valid()) m_saving.wait();
+  m_saving = m_package->saveAsync(m_filename.toStdString());
 }
 
 void PackageView::dragEnterEvent(QDragEnterEvent *a_event)
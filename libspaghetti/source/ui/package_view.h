@@ -28,6 +28,7 @@
 #include <QGraphicsView>
 #include <QHash>
 #include <QTimer>
+#include <future>
 
 class QTableWidget;
 class QListView;
@@ -143,6 +144,7 @@ class PackageView final : public QGraphicsView {
   int32_t m_scheduledScalings{};
   enum class GridDensity { eLarge, eSmall } m_gridDensity{};
   QString m_filename{};
+  std::future<bool> m_saving{};
   bool m_snapToGrid{};
   bool m_standalone{};
 };